@@ -0,0 +1,71 @@
+#include "accounts.h"
+
+uint32_t Accounts::find(uint64_t id) const {
+    if (id == DUST_ACCOUNT_ID)
+        return DUST_SLOT;
+
+    for (uint32_t i = account_index_hash(id);; i = (i + 1) & (ACCOUNT_INDEX_SIZE - 1)) {
+        const AccountIndexEntry& e = index[i];
+        if (e.slot == 0) return NO_ACCOUNT;
+        if (e.id == id)  return e.slot;
+    }
+}
+
+uint32_t Accounts::open(uint64_t id) {
+    if (id == DUST_ACCOUNT_ID)
+        return DUST_SLOT;
+
+    uint32_t i = account_index_hash(id);
+    for (;; i = (i + 1) & (ACCOUNT_INDEX_SIZE - 1)) {
+        const AccountIndexEntry& e = index[i];
+        if (e.slot == 0) break;
+        if (e.id == id)  return e.slot;
+    }
+
+    // Slots [1, MAX_ACCOUNTS - 1] are assignable; slot 0 is dust
+    if (count >= MAX_ACCOUNTS - 1)
+        return NO_ACCOUNT;
+
+    uint32_t slot = ++count;
+    index[i].id   = id;
+    index[i].slot = slot;
+
+    hot[slot]  = AccountHot{};
+    cold[slot] = AccountCold{};
+    cold[slot].external_id = id;
+
+    return slot;
+}
+
+void Accounts::reindex() {
+    for (uint32_t i = 0; i < ACCOUNT_INDEX_SIZE; ++i)
+        index[i] = AccountIndexEntry{};
+
+    for (uint32_t slot = 1; slot <= count; ++slot) {
+        uint64_t id = cold[slot].external_id;
+
+        uint32_t i = account_index_hash(id);
+        while (index[i].slot != 0)
+            i = (i + 1) & (ACCOUNT_INDEX_SIZE - 1);
+
+        index[i].id   = id;
+        index[i].slot = slot;
+    }
+}
+
+bool Accounts::logical_equals(const Accounts& o) const {
+    if (count != o.count)
+        return false;
+
+    for (uint32_t s = 0; s < live_end(); ++s) {
+        if (hot[s].base_available  != o.hot[s].base_available)  return false;
+        if (hot[s].quote_available != o.hot[s].quote_available) return false;
+        if (hot[s].state           != o.hot[s].state)           return false;
+        if (cold[s].base_locked    != o.cold[s].base_locked)    return false;
+        if (cold[s].quote_locked   != o.cold[s].quote_locked)   return false;
+        if (cold[s].external_id    != o.cold[s].external_id)    return false;
+        if (cold[s].order_head     != o.cold[s].order_head)     return false;
+        if (cold[s].order_tail     != o.cold[s].order_tail)     return false;
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+
+// Live account slots (the dust account always occupies slot 0)
+constexpr uint32_t MAX_ACCOUNTS = 1u << 17;
+
+// Open-addressed id -> slot index, kept at most half full
+constexpr uint32_t ACCOUNT_INDEX_BITS = 18;
+constexpr uint32_t ACCOUNT_INDEX_SIZE = 1u << ACCOUNT_INDEX_BITS;
+
+constexpr uint32_t NO_ACCOUNT = UINT32_MAX;
+
+// Dust account
+constexpr uint64_t DUST_ACCOUNT_ID = 0;
+constexpr uint32_t DUST_SLOT = 0;
+
+// =======================
+// Balance Width
+// =======================
+//
+// Compile-time choice of balance storage and arithmetic (build with
+// -DENGINE_BALANCE_BITS=64 or 128). 128 bits cannot overflow on any
+// price * quantity; 64 bits halves the account rows and keeps fill math
+// in single registers, with the products that could overflow checked.
+
+#ifndef ENGINE_BALANCE_BITS
+#define ENGINE_BALANCE_BITS 128
+#endif
+
+template <int Bits> struct BalanceWidth;
+template <> struct BalanceWidth<64>  { using type = int64_t; };
+template <> struct BalanceWidth<128> { using type = __int128; };
+
+using Balance = BalanceWidth<ENGINE_BALANCE_BITS>::type;
+
+// False when the result does not fit in Balance. With 128 bits neither
+// can fail on 64-bit operands and the checks fold away.
+inline bool balance_mul(int64_t a, int64_t b, Balance& out) {
+    return !__builtin_mul_overflow(a, b, &out);
+}
+
+inline bool balance_add(Balance a, Balance b, Balance& out) {
+    return !__builtin_add_overflow(a, b, &out);
+}
+
+enum class AccountState : uint8_t {
+    ACTIVE,
+    FROZEN
+};
+
+// Read on every order and written on every fill
+struct AccountHot {
+    Balance      base_available;
+    Balance      quote_available;
+    AccountState state;
+};
+
+// Reservations, identity and the account's resting orders
+struct AccountCold {
+    Balance  base_locked;
+    Balance  quote_locked;
+    uint64_t external_id;
+    uint32_t order_head;    // Orders::acct_prev / acct_next list
+    uint32_t order_tail;
+};
+
+inline uint32_t account_index_hash(uint64_t id) {
+    return static_cast<uint32_t>(
+        (id * 0x9E3779B97F4A7C15ull) >> (64 - ACCOUNT_INDEX_BITS));
+}
+
+struct AccountIndexEntry {
+    uint64_t id;
+    uint32_t slot;     // 0 = empty (slot 0 is dust and never indexed)
+};
+
+// External account id -> dense slot. An all-zero Accounts is a valid empty
+// table holding only the dust account, so zero_state() needs no init step.
+struct Accounts {
+    AccountHot        hot[MAX_ACCOUNTS];
+    AccountCold       cold[MAX_ACCOUNTS];
+    AccountIndexEntry index[ACCOUNT_INDEX_SIZE];
+
+    uint32_t count;    // slots [1, count] are in use
+
+    // Slots [0, live_end()) are live
+    inline uint32_t live_end() const { return count + 1; }
+
+    // NO_ACCOUNT if the id has never been opened
+    uint32_t find(uint64_t id) const;
+
+    // Find or assign a slot; NO_ACCOUNT when the table is full
+    uint32_t open(uint64_t id);
+
+    // Rebuild `index` from cold[].external_id. Slots are inserted in the
+    // order open() assigned them, so every entry lands where it was.
+    void reindex();
+
+    bool logical_equals(const Accounts& o) const;
+};
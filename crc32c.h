@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// =======================
+// CRC32C (Castagnoli)
+// =======================
+//
+// SSE4.2 crc32 instruction when the build targets it, otherwise a
+// byte-wise table. Both produce the same value.
+
+#if defined(__SSE4_2__)
+
+inline uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t c = ~crc;
+
+    while (len >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        c = __builtin_ia32_crc32di(c, v);
+        p += 8;
+        len -= 8;
+    }
+
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (len--)
+        c32 = __builtin_ia32_crc32qi(c32, *p++);
+
+    return ~c32;
+}
+
+#else
+
+struct Crc32cTable {
+    uint32_t t[256];
+
+    constexpr Crc32cTable() : t{} {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+            t[i] = c;
+        }
+    }
+};
+
+inline constexpr Crc32cTable CRC32C_TABLE{};
+
+inline uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t c = ~crc;
+
+    while (len--)
+        c = CRC32C_TABLE.t[(c ^ *p++) & 0xFF] ^ (c >> 8);
+
+    return ~c;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#include "engine_state.h"
+#include <cstddef>
+#include <cstdint>
+
+// =======================
+// Dirty Region Tracker
+// =======================
+//
+// One bit per DIRTY_PAGE_BYTES of EngineState. The engine marks the
+// orders, accounts and book entries it writes. A delta snapshot is then
+// just the marked pages, so its size follows activity since the base
+// rather than sizeof(EngineState). Lives outside EngineState: it is
+// bookkeeping about the state, not part of it.
+
+constexpr size_t DIRTY_PAGE_BYTES = 4096;
+constexpr size_t DIRTY_PAGES =
+    (sizeof(EngineState) + DIRTY_PAGE_BYTES - 1) / DIRTY_PAGE_BYTES;
+constexpr size_t DIRTY_WORDS = (DIRTY_PAGES + 63) / 64;
+
+struct DirtyTracker {
+    const uint8_t* base = nullptr;
+    uint64_t       bits[DIRTY_WORDS] = {};
+
+    explicit DirtyTracker(const EngineState& state)
+        : base(reinterpret_cast<const uint8_t*>(&state)) {}
+
+    // Call when the base snapshot is taken
+    void clear() {
+        for (size_t i = 0; i < DIRTY_WORDS; ++i) bits[i] = 0;
+    }
+
+    inline void mark(const void* p, size_t n) {
+        size_t off = static_cast<size_t>(static_cast<const uint8_t*>(p) - base);
+        size_t first = off / DIRTY_PAGE_BYTES;
+        size_t last = (off + n - 1) / DIRTY_PAGE_BYTES;
+        for (size_t pg = first; pg <= last; ++pg)
+            bits[pg >> 6] |= 1ull << (pg & 63);
+    }
+
+    template <typename T>
+    inline void mark(const T& field) { mark(&field, sizeof(T)); }
+
+    inline bool test(size_t page) const {
+        return (bits[page >> 6] >> (page & 63)) & 1;
+    }
+
+    size_t dirty_pages() const {
+        size_t n = 0;
+        for (size_t i = 0; i < DIRTY_WORDS; ++i)
+            n += static_cast<size_t>(__builtin_popcountll(bits[i]));
+        return n;
+    }
+};
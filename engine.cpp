@@ -1,17 +1,15 @@
 #include "engine.h"
 #include "perf.h"
+#include "instruments.h"
 #include <algorithm>
 #include <cstdlib>
 #include "engine_common.h"
+#include "fee.h"
 
 // =======================
 // Helpers
 // =======================
 
-static inline __int128 fee_ceiling(__int128 value) {
-    return (value * FEE_NUMERATOR + FEE_DENOMINATOR - 1) / FEE_DENOMINATOR;
-}
-
 static inline void fatal(const char*) {
     ENGINE_ABORT("reason");
 }
@@ -20,19 +18,26 @@ static inline void fatal(const char*) {
 // Constructor
 // =======================
 
-MatchingEngine::MatchingEngine(EngineState& state)
-    : state_(state) {
-    state_.orders.init();
-
-    const int64_t MIN_P = 1'000'000;
-    const int64_t MAX_P = MIN_P + MAX_TICKS;
-    state_.book.init(MIN_P, MAX_P);
+MatchingEngine::MatchingEngine(EngineState& state,
+                               ExecutionRing* reports,
+                               DirtyTracker* dirty,
+                               DepthRing* depth,
+                               StateDigest* digest,
+                               PerfRing* perf)
+    : state_(state), reports_(reports), dirty_(dirty), depth_(depth),
+      digest_(digest), perf_(perf),
+      pool_(perf ? &perf->level_pool : nullptr) {
+    // A restored state (snapshot / recovery) is attached as-is; only a
+    // zeroed one has never been initialised.
+    if (state_.orders.slot_top == 0)
+        init_instrument(state_, DEFAULT_INSTRUMENT);
+
+    if (digest_) digest_->rebuild(state_);
 }
 
 // =======================
 // Dispatcher
 // =======================
-extern PerfRing g_perf;
 
 inline uint64_t rdtsc() {
 #if defined(__x86_64__) || defined(_M_X64)
@@ -46,12 +51,66 @@ inline uint64_t rdtsc() {
 }
 
 void MatchingEngine::apply(const EngineEvent& event) {
-    uint64_t start = rdtsc();
+    uint64_t start = perf_ ? rdtsc() : 0;
     if (event.header.sequence != state_.last_sequence + 1)
         fatal("sequence violation");
 
     state_.last_sequence = event.header.sequence;
 
+    if (dirty_) {
+        dirty_->mark(state_.last_sequence);
+        dirty_->mark(state_.last_grc_sequence);
+    }
+
+    dispatch(event);
+    if (digest_) digest_->fold(state_);
+    if (perf_) perf_->record(event.header.sequence, start, rdtsc());
+}
+
+// Events ahead of the one being applied: index entries are prefetched
+// BATCH_PREFETCH_FAR ahead, the rows they point at BATCH_PREFETCH_NEAR
+// ahead, by which time those entries are in cache.
+constexpr size_t BATCH_PREFETCH_FAR  = 8;
+constexpr size_t BATCH_PREFETCH_NEAR = 4;
+
+void MatchingEngine::apply_batch(const EngineEvent* events, size_t n) {
+    if (n == 0) return;
+
+    uint64_t start = perf_ ? rdtsc() : 0;
+
+    const uint64_t first = state_.last_sequence + 1;
+    for (size_t i = 0; i < n; ++i)
+        if (events[i].header.sequence != first + i)
+            fatal("sequence violation");
+
+    if (dirty_) {
+        dirty_->mark(state_.last_sequence);
+        dirty_->mark(state_.last_grc_sequence);
+    }
+
+    for (size_t i = 0; i < n && i < BATCH_PREFETCH_FAR; ++i)
+        prefetch(events[i]);
+    for (size_t i = 0; i < n && i < BATCH_PREFETCH_NEAR; ++i)
+        prefetch_rows(events[i]);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (i + BATCH_PREFETCH_FAR < n)
+            prefetch(events[i + BATCH_PREFETCH_FAR]);
+        if (i + BATCH_PREFETCH_NEAR < n)
+            prefetch_rows(events[i + BATCH_PREFETCH_NEAR]);
+
+        // Reports carry the sequence of the event that produced them
+        state_.last_sequence = events[i].header.sequence;
+        dispatch(events[i]);
+    }
+
+    // Once per batch: a row the burst touched repeatedly is hashed once
+    if (digest_) digest_->fold(state_);
+
+    if (perf_) perf_->record(state_.last_sequence, start, rdtsc());
+}
+
+void MatchingEngine::dispatch(const EngineEvent& event) {
     switch (event.header.type) {
         case EventType::NEW_ORDER:     on_new_order(event.new_order); break;
         case EventType::CANCEL:        on_cancel(event.cancel); break;
@@ -59,8 +118,129 @@ void MatchingEngine::apply(const EngineEvent& event) {
         case EventType::TIME_PULSE:    on_time(event.time); break;
         case EventType::MARKET_ORDER:  on_market(event.market); break;
     }
-    uint64_t end = rdtsc();
-    g_perf.record(event.header.sequence, start, end);
+
+    // Updates carry the sequence of the event that made them
+    if (depth_pending_) flush_level();
+}
+
+// =======================
+// Prefetch
+// =======================
+
+void MatchingEngine::prefetch(const EngineEvent& event) const {
+    const Accounts& accts = state_.accounts;
+    const Orders& orders = state_.orders;
+    const OrderBook& book = state_.book;
+
+    switch (event.header.type) {
+        case EventType::NEW_ORDER: {
+            const NewOrderEvent& ev = event.new_order;
+            __builtin_prefetch(&accts.index[account_index_hash(ev.account_id)]);
+
+            if (book.backend != LevelBackend::DENSE ||
+                !book.indexable(ev.price))
+                break;
+
+            int32_t idx = book.price_to_index(ev.price);
+            __builtin_prefetch(ev.side == BUY ? &book.buy_levels[idx]
+                                              : &book.sell_levels[idx]);
+            break;
+        }
+
+        case EventType::CANCEL: {
+            uint64_t oid = event.cancel.order_id & ORDER_SLOT_MASK;
+            if (oid >= MAX_ORDERS) break;
+            __builtin_prefetch(&orders.hot[oid]);
+            __builtin_prefetch(&orders.cold[oid]);
+            break;
+        }
+
+        case EventType::RISK_CONTROL:
+            __builtin_prefetch(
+                &accts.index[account_index_hash(event.risk.account_id)]);
+            break;
+
+        case EventType::MARKET_ORDER:
+            __builtin_prefetch(
+                &accts.index[account_index_hash(event.market.account_id)]);
+            break;
+
+        case EventType::TIME_PULSE:
+            break;
+    }
+}
+
+// Only the home bucket is followed; a probed entry just goes unprefetched
+static inline void prefetch_account_rows(const Accounts& accts, uint64_t id) {
+    const AccountIndexEntry& e = accts.index[account_index_hash(id)];
+    if (e.slot && e.id == id) {
+        __builtin_prefetch(&accts.hot[e.slot]);
+        __builtin_prefetch(&accts.cold[e.slot]);
+    }
+}
+
+void MatchingEngine::prefetch_rows(const EngineEvent& event) const {
+    const Accounts& accts = state_.accounts;
+    const Orders& orders = state_.orders;
+    const OrderBook& book = state_.book;
+
+    switch (event.header.type) {
+        case EventType::NEW_ORDER: {
+            const NewOrderEvent& ev = event.new_order;
+            prefetch_account_rows(accts, ev.account_id);
+
+            // The contra best level is where matching starts
+            uint32_t h = (ev.side == BUY) ? book.best_ask_level
+                                          : book.best_bid_level;
+            if (h) {
+                __builtin_prefetch(&book.level_pool[h]);
+                uint32_t head = book.level_pool[h].head;
+                __builtin_prefetch(&orders.hot[head]);
+            }
+
+            if (book.backend == LevelBackend::DENSE &&
+                book.indexable(ev.price)) {
+                int32_t idx = book.price_to_index(ev.price);
+                uint32_t own = (ev.side == BUY) ? book.buy_levels[idx]
+                                                : book.sell_levels[idx];
+                if (own) __builtin_prefetch(&book.level_pool[own]);
+            }
+            break;
+        }
+
+        case EventType::CANCEL: {
+            uint32_t oid = orders.find(event.cancel.order_id);
+            if (!oid) break;
+
+            // Own row came in with prefetch(); the unlink also writes
+            // the level neighbours
+            const OrderHot& h = orders.hot[oid];
+            __builtin_prefetch(&accts.hot[h.account]);
+            __builtin_prefetch(&accts.cold[h.account]);
+            __builtin_prefetch(&orders.hot[h.prev]);
+            __builtin_prefetch(&orders.hot[h.next]);
+
+            if (book.backend == LevelBackend::DENSE) {
+                int32_t idx = book.price_to_index(orders.cold[oid].price);
+                const uint32_t* levels =
+                    (h.side == OrderSide::BUY) ? book.buy_levels
+                                               : book.sell_levels;
+                __builtin_prefetch(&book.level_pool[levels[idx]]);
+            }
+            break;
+        }
+
+        case EventType::RISK_CONTROL:
+            prefetch_account_rows(accts, event.risk.account_id);
+            break;
+
+        case EventType::MARKET_ORDER:
+            prefetch_account_rows(accts, event.market.account_id);
+            break;
+
+        case EventType::TIME_PULSE:
+            break;
+    }
 }
 
 // =======================
@@ -73,48 +253,50 @@ void MatchingEngine::on_risk(const RiskControlEvent& rce) {
 
     state_.last_grc_sequence = rce.grc_sequence;
 
-    Account& acct = state_.accounts[rce.account_id];
+    Accounts& accts = state_.accounts;
+
+    // Freezing an unseen account opens it so later orders are refused
+    uint32_t slot = (rce.command == RiskCommand::ACCOUNT_FREEZE)
+                        ? accts.open(rce.account_id)
+                        : accts.find(rce.account_id);
+    if (slot == NO_ACCOUNT)
+        return;
+
+    if (rce.command == RiskCommand::ACCOUNT_FREEZE && dirty_) {
+        touch_account_index(rce.account_id);
+        dirty_->mark(accts.count);
+    }
+    touch_account(slot);
 
     switch (rce.command) {
         case RiskCommand::ACCOUNT_FREEZE:
-            acct.state = AccountState::FROZEN;
+            accts.hot[slot].state = AccountState::FROZEN;
             break;
 
-        case RiskCommand::PURGE_ORDERS: {
-            for (uint64_t oid = 1; oid < state_.orders.next_order_id; ++oid) {
-                if (state_.orders.account_id[oid] != rce.account_id) continue;
-                if (state_.orders.state[oid] != OrderState::LIVE) continue;
-
-                int64_t rem = state_.orders.qty_remaining[oid];
-                if (rem <= 0) continue;
-
-                if (state_.orders.side[oid] == OrderSide::BUY) {
-                    __int128 notional = (__int128)state_.orders.price[oid] * rem;
-                    __int128 fee = fee_ceiling(notional);
-                    acct.quote.locked    -= (notional + fee);
-                    acct.quote.available += (notional + fee);
-                } else {
-                    acct.base.locked    -= rem;
-                    acct.base.available += rem;
-                }
-
-                state_.orders.state[oid] = OrderState::CANCELLED;
-            }
+        case RiskCommand::PURGE_ORDERS:
+            cancel_account_orders(slot);
             break;
-        }
 
         case RiskCommand::LIQUIDATION_MARKET: {
-            MarketOrderEvent m;
+            if (rce.instrument != state_.instrument)
+                break;
+
+            // Its resting orders go first, so what they held is
+            // available to the sweep
+            cancel_account_orders(slot);
+
+            MarketOrderEvent m{};
             m.account_id = rce.account_id;
+            m.instrument = rce.instrument;
             m.quantity   = rce.quantity;
 
             // decide side deterministically
-            if (acct.base.available + acct.base.locked > 0)
+            if (accts.hot[slot].base_available + accts.cold[slot].base_locked > 0)
                 m.side = SELL;
             else
                 m.side = BUY;
 
-            on_market(m);
+            on_market(m, true);
             break;
         }
     }
@@ -124,45 +306,103 @@ void MatchingEngine::on_risk(const RiskControlEvent& rce) {
 // LIMIT Orders
 // =======================
 
+// Books on the default tick take the constant-tick instantiation, where
+// the price <-> index divide and multiply fold away; any other tick size
+// goes through the runtime one. The branch is the same for every order
+// of a book, so it predicts perfectly.
 void MatchingEngine::on_new_order(const NewOrderEvent& ev) {
-    Account& acct = state_.accounts[ev.account_id];
-    if (acct.state == AccountState::FROZEN)
+    if (state_.book.tick_size == TICK_SIZE)
+        on_limit<FixedTicks<TICK_SIZE>>(ev);
+    else
+        on_limit<RuntimeTicks>(ev);
+}
+
+template <class Ticks>
+void MatchingEngine::on_limit(const NewOrderEvent& ev) {
+    if (ev.instrument != state_.instrument) {
+        emit_report(ExecType::REJECTED, RejectReason::UNKNOWN_INSTRUMENT,
+                    0, ev.account_id, ev.side, ev.price, ev.quantity);
+        return;
+    }
+
+    Accounts& accts = state_.accounts;
+
+    uint32_t slot = accts.find(ev.account_id);
+    if (slot == NO_ACCOUNT) {
+        emit_report(ExecType::REJECTED, RejectReason::UNKNOWN_ACCOUNT,
+                    0, ev.account_id, ev.side, ev.price, ev.quantity);
+        return;
+    }
+
+    AccountHot&  hot  = accts.hot[slot];
+    AccountCold& cold = accts.cold[slot];
+
+    if (hot.state == AccountState::FROZEN) {
+        emit_report(ExecType::REJECTED, RejectReason::ACCOUNT_FROZEN,
+                    0, ev.account_id, ev.side, ev.price, ev.quantity);
         return;
+    }
 
     Orders& orders = state_.orders;
     OrderBook& book = state_.book;
 
+    if (orders.full()) {
+        emit_report(ExecType::REJECTED, RejectReason::ORDER_CAPACITY,
+                    0, ev.account_id, ev.side, ev.price, ev.quantity);
+        return;
+    }
+
+    touch_account(slot);
+    touch_account(DUST_SLOT);
+
     // ----------------------------
     // LOCK FUNDS
     // ----------------------------
-    __int128 lock_amount = 0;
+    Balance lock_amount = 0;
 
     if (ev.side == BUY) {
-        __int128 notional = (__int128)ev.price * ev.quantity;
-        lock_amount = notional + fee_ceiling(notional);
-
-        if (acct.quote.available < lock_amount)
+        // A lock too large for Balance is more than any account can hold,
+        // so overflow is refused like any other shortfall. Every later
+        // product on this order is bounded by a lock that fit.
+        Balance notional;
+        bool fits = balance_mul(ev.price, ev.quantity, notional) &&
+                    balance_add(notional, fee_ceiling(notional), lock_amount);
+
+        if (!fits || hot.quote_available < lock_amount) {
+            emit_report(ExecType::REJECTED, RejectReason::INSUFFICIENT_FUNDS,
+                        0, ev.account_id, ev.side, ev.price, ev.quantity);
             return;
+        }
 
-        acct.quote.available -= lock_amount;
-        acct.quote.locked    += lock_amount;
+        hot.quote_available -= lock_amount;
+        cold.quote_locked   += lock_amount;
     } else {
-        if (acct.base.available < ev.quantity)
+        if (hot.base_available < ev.quantity) {
+            emit_report(ExecType::REJECTED, RejectReason::INSUFFICIENT_FUNDS,
+                        0, ev.account_id, ev.side, ev.price, ev.quantity);
             return;
+        }
 
-        acct.base.available -= ev.quantity;
-        acct.base.locked    += ev.quantity;
+        hot.base_available -= ev.quantity;
+        cold.base_locked   += ev.quantity;
     }
 
-    uint64_t taker_oid = orders.create(
-        ev.account_id,
+    uint32_t taker_oid = orders.create(
+        slot,
         ev.side == BUY ? OrderSide::BUY : OrderSide::SELL,
         ev.price,
-        ev.quantity
+        ev.quantity,
+        state_.last_sequence
     );
+    touch_order(taker_oid);
+
+    emit_report(ExecType::ACCEPTED, RejectReason::NONE,
+                orders.cold[taker_oid].id, ev.account_id, ev.side, ev.price,
+                ev.quantity);
 
     int64_t remaining = ev.quantity;
-    __int128 spent_notional = 0;
+    Balance spent_notional = 0;
+    bool balance_limit = false;
 
     // ----------------------------
     // MATCHING
@@ -171,80 +411,33 @@ void MatchingEngine::on_new_order(const NewOrderEvent& ev) {
         int32_t& best =
             (contra_side == BUY) ? book.best_bid : book.best_ask;
 
-        PriceLevel** levels =
-            (contra_side == BUY) ? book.buy_levels : book.sell_levels;
-
         while (remaining > 0 && best != -1) {
             int32_t idx = best;
-            int64_t price = book.min_price + idx * TICK_SIZE;
+            int64_t price = book.index_to_price<Ticks>(idx);
 
             if ((ev.side == BUY  && price > ev.price) ||
                 (ev.side == SELL && price < ev.price))
                 break;
 
-            PriceLevel* lvl = levels[idx];
+            PriceLevel* lvl = book.best_level(contra_side);
             if (!lvl) break;
 
-            while (remaining > 0 && lvl->head < lvl->tail) {
-                uint32_t maker_oid =
-                    lvl->order_ids[lvl->head % MAX_LEVEL_ORDERS];
-
-                if (orders.state[maker_oid] != OrderState::LIVE) {
-                    lvl->head++;
-                    continue;
-                }
-
+            // Levels only hold live orders; an emptied level is released
+            // by remove_order, which also advances `best`.
+            while (remaining > 0 && lvl->head) {
+                uint32_t maker_oid = lvl->head;
                 int64_t traded =
-                    std::min(remaining, orders.qty_remaining[maker_oid]);
-
-                remaining -= traded;
-                orders.qty_remaining[maker_oid] -= traded;
-
-                uint64_t maker_acct_id = orders.account_id[maker_oid];
-
-                Account& buyer =
-                    (ev.side == BUY)
-                        ? acct
-                        : state_.accounts[maker_acct_id];
-
-                Account& seller =
-                    (ev.side == BUY)
-                        ? state_.accounts[maker_acct_id]
-                        : acct;
-
-                __int128 trade_value = (__int128)price * traded;
-
-                // ----------------------------
-                // SETTLEMENT (NO FEES HERE)
-                // ----------------------------
-                // SETTLEMENT
-                buyer.base.available += traded;
-                seller.quote.available += trade_value;
-
-                // Release maker locks correctly
-                if (orders.side[maker_oid] == OrderSide::BUY) {
-                    // BUY maker locked (price * qty + fee)
-                    __int128 maker_fee = fee_ceiling(trade_value);
-                    buyer.quote.locked -= (trade_value + maker_fee);
-                    state_.accounts[DUST_ACCOUNT_ID].quote.available += maker_fee;
-                } else {
-                    // SELL maker locked base only
-                    seller.base.locked -= traded;
-                }
-
-                spent_notional += trade_value;
+                    std::min(remaining, orders.hot[maker_oid].qty_remaining);
 
-                emit_trade({taker_oid, maker_oid, price, traded});
-
-                if (orders.qty_remaining[maker_oid] == 0) {
-                    orders.state[maker_oid] = OrderState::FILLED;
-                    lvl->head++;
+                if (!credits_fit(slot, ev.side, maker_oid, price, traded,
+                                 spent_notional)) {
+                    balance_limit = true;
+                    return;
                 }
-            }
 
-            if (lvl->head == lvl->tail) {
-                levels[idx] = nullptr;
-                book.update_best_on_level_empty(contra_side, idx);
+                remaining -= traded;
+                spent_notional += fill_maker(taker_oid, slot, ev.side, *lvl,
+                                             idx, price, maker_oid, traded);
             }
         }
     };
@@ -254,74 +447,374 @@ void MatchingEngine::on_new_order(const NewOrderEvent& ev) {
     // ----------------------------
     // APPLY FEE ONCE (BOTH SIDES)
     // ----------------------------
-    __int128 total_fee = fee_ceiling(spent_notional);
+    Balance total_fee = fee_ceiling(spent_notional);
 
     if (spent_notional > 0) {
         if (ev.side == BUY) {
-            // BUY taker pays fee from locked quote
-            acct.quote.locked -= total_fee;
+            // BUY taker pays notional + fee from locked quote
+            cold.quote_locked -= (spent_notional + total_fee);
         } else {
             // SELL taker pays fee from received quote
-            acct.quote.available -= total_fee;
+            hot.quote_available -= total_fee;
         }
 
-        state_.accounts[DUST_ACCOUNT_ID].quote.available += total_fee;
+        accts.hot[DUST_SLOT].quote_available += total_fee;
     }
 
     // ----------------------------
     // REFUND UNUSED LOCKS
     // ----------------------------
+    // A remainder stopped by a balance limit still crosses: never rest it
+    bool in_band = remaining > 0 && !balance_limit &&
+                   (book.indexable<Ticks>(ev.price) ||
+                    (book.auto_recenter && recenter_book(ev.price)));
+    int32_t rest_idx = in_band ? book.price_to_index<Ticks>(ev.price) : -1;
+    bool rests = in_band && book.can_rest(ev.side, rest_idx);
+
     if (ev.side == BUY) {
-        __int128 refund =
-            lock_amount - (spent_notional + total_fee);
+        // What the fills left of the lock is never negative: they ran at
+        // or below ev.price, and the fee only grows with the notional. A
+        // resting remainder keeps (price * qty + fee) of it, or all of it
+        // when the fee's rounding left less; that reservation is all that
+        // maker fills and cancel will ever release.
+        Balance left = lock_amount - (spent_notional + total_fee);
+        Balance reserved = 0;
+        if (rests) {
+            Balance rest_notional = Balance{ev.price} * remaining;
+            reserved = std::min(left, rest_notional +
+                                      fee_ceiling(rest_notional));
+        }
+        orders.cold[taker_oid].quote_reserved = reserved;
 
-        acct.quote.locked    -= refund;
-        acct.quote.available += refund;
+        cold.quote_locked   -= left - reserved;
+        hot.quote_available += left - reserved;
     } else {
-        acct.base.locked -= (ev.quantity - remaining);
+        cold.base_locked -= (ev.quantity - remaining);
+        if (remaining > 0 && !rests) {
+            cold.base_locked   -= remaining;
+            hot.base_available += remaining;
+        }
     }
 
-    orders.qty_remaining[taker_oid] = remaining;
+    orders.hot[taker_oid].qty_remaining = remaining;
 
     if (remaining > 0) {
-        int32_t idx = book.price_to_index(ev.price);
-        if (idx >= 0 && idx < MAX_TICKS)
-            book.add_order(ev.side, idx, taker_oid);
-        else
-            orders.state[taker_oid] = OrderState::CANCELLED;
+        if (rests) {
+            book_add(ev.side, rest_idx, taker_oid);
+        } else {
+            orders.hot[taker_oid].state = OrderState::CANCELLED;
+            emit_report(ExecType::CANCELLED,
+                        balance_limit ? RejectReason::BALANCE_LIMIT
+                        : in_band     ? RejectReason::LEVEL_CAPACITY
+                                      : RejectReason::PRICE_OUT_OF_BAND,
+                        orders.cold[taker_oid].id, ev.account_id, ev.side,
+                        ev.price, remaining);
+            release_order(taker_oid);
+        }
     } else {
-        orders.state[taker_oid] = OrderState::FILLED;
+        orders.hot[taker_oid].state = OrderState::FILLED;
+        release_order(taker_oid);
     }
 }
 
+// A recenter renumbers every level, so the whole book is dirty
+bool MatchingEngine::recenter_book(int64_t price) {
+    if (!state_.book.recenter(price))
+        return false;
+
+    if (dirty_) dirty_->mark(state_.book);
+    if (perf_) perf_->band_recenters++;
+    return true;
+}
+
 // =======================
-// MARKET Orders (safe)
+// Fills
 // =======================
 
-void MatchingEngine::on_market(const MarketOrderEvent& ev) {
-    Account& acct = state_.accounts[ev.account_id];
-    if (acct.state == AccountState::FROZEN) return;
+// A fill credits the buyer's base, the seller's quote and the dust
+// slot's fees. With 64-bit balances each is checked before the fill:
+// every account's available + locked must stay within Balance, so the
+// locks a later fill, cancel or refund hands back always fit too, and
+// the dust slot must take this fill's maker fee plus the taker's whole
+// fee so far. Balances are conserved, so this only trips when the
+// balances seeded into the engine together exceed Balance. With 128
+// bits no 64-bit operand can get near, and the check is compiled out.
+inline bool MatchingEngine::credits_fit(uint32_t taker_slot,
+                                        uint8_t taker_side,
+                                        uint32_t maker_oid,
+                                        int64_t price,
+                                        int64_t traded,
+                                        Balance spent_notional) const {
+    if constexpr (sizeof(Balance) > sizeof(int64_t)) {
+        return true;
+    } else {
+        const Accounts& a = state_.accounts;
+        uint32_t maker_slot = state_.orders.hot[maker_oid].account;
+        uint32_t buyer  = (taker_side == BUY) ? taker_slot : maker_slot;
+        uint32_t seller = (taker_side == BUY) ? maker_slot : taker_slot;
+
+        Balance value, base, quote, taker_notional, fees, dust;
+        return balance_mul(price, traded, value) &&
+               balance_add(a.hot[buyer].base_available,
+                           a.cold[buyer].base_locked, base) &&
+               balance_add(base, traded, base) &&
+               balance_add(a.hot[seller].quote_available,
+                           a.cold[seller].quote_locked, quote) &&
+               balance_add(quote, value, quote) &&
+               balance_add(spent_notional, value, taker_notional) &&
+               balance_add(fee_ceiling(value), fee_ceiling(taker_notional),
+                           fees) &&
+               balance_add(a.hot[DUST_SLOT].quote_available, fees, dust);
+    }
+}
 
-    int64_t remaining = ev.quantity;
+// Takes `traded` lots from the maker at the head of the contra level
+// `lvl` (at `idx`) and settles both sides of the trade. The maker's fee
+// and lock come out here; the taker's fee is charged once per order by
+// the caller. Returns the trade's notional.
+inline Balance MatchingEngine::fill_maker(uint32_t taker_oid,
+                                          uint32_t taker_slot,
+                                          uint8_t taker_side,
+                                          PriceLevel& lvl,
+                                          int32_t idx,
+                                          int64_t price,
+                                          uint32_t maker_oid,
+                                          int64_t traded) {
+    Orders& orders = state_.orders;
+    Accounts& accts = state_.accounts;
+    OrderHot& maker = orders.hot[maker_oid];
 
-    while (remaining > 0 &&
-           (ev.side == BUY ? state_.book.best_ask : state_.book.best_bid) != -1) {
+    // The next maker, and the account-list neighbours a fill unlinks
+    // from, are lines no one has touched since they rested: start them
+    // loading during settlement
+    __builtin_prefetch(&orders.hot[maker.next]);
+    __builtin_prefetch(&orders.hot[maker.acct_prev]);
+    __builtin_prefetch(&orders.hot[maker.acct_next]);
 
-        if (ev.side == BUY && acct.quote.available <= 0) break;
-        if (ev.side == SELL && acct.base.available <= 0) break;
+    maker.qty_remaining -= traded;
+    lvl.quantity -= traded;
 
-        // Reuse LIMIT matcher by synthetic limit
-        NewOrderEvent synthetic{};
-        synthetic.account_id = ev.account_id;
-        synthetic.side = ev.side;
-        synthetic.quantity = remaining;
-        synthetic.price = (ev.side == BUY)
-            ? INT64_MAX
-            : 0;
+    uint32_t maker_slot = maker.account;
+    uint8_t maker_side = (taker_side == BUY) ? SELL : BUY;
 
-        on_new_order(synthetic);
-        break;
+    touch_order(maker_oid);
+    touch_account(maker_slot);
+    touch_level_row(static_cast<uint32_t>(&lvl - state_.book.level_pool));
+    note_level(maker_side, idx);
+
+    uint32_t buyer  = (taker_side == BUY) ? taker_slot : maker_slot;
+    uint32_t seller = (taker_side == BUY) ? maker_slot : taker_slot;
+
+    Balance trade_value = Balance{price} * traded;
+
+    // ----------------------------
+    // SETTLEMENT
+    // ----------------------------
+    accts.hot[buyer].base_available   += traded;
+    accts.hot[seller].quote_available += trade_value;
+
+    // Release maker locks correctly
+    if (maker.side == OrderSide::BUY) {
+        // Paid from the order's own reservation. Ceiling fees are not
+        // additive, so the fee is capped at what the reservation holds
+        // beyond the notional still owed; the last fill hands back the
+        // rest.
+        Balance& reserved = orders.cold[maker_oid].quote_reserved;
+        Balance owed = Balance{price} * maker.qty_remaining;
+        Balance maker_fee = std::min(fee_ceiling(trade_value),
+                                     reserved - trade_value - owed);
+        Balance release = trade_value + maker_fee;
+        if (maker.qty_remaining == 0) {
+            accts.hot[buyer].quote_available += reserved - release;
+            release = reserved;
+        }
+        reserved -= release;
+        accts.cold[buyer].quote_locked -= release;
+        accts.hot[DUST_SLOT].quote_available += maker_fee;
+    } else {
+        // SELL maker locked base only
+        accts.cold[seller].base_locked -= traded;
     }
+
+    emit_trade({taker_oid, maker_oid, price, traded});
+
+    if (maker.qty_remaining == 0) {
+        maker.state = OrderState::FILLED;
+        book_remove(maker_side, idx, maker_oid);
+        release_order(maker_oid);
+    }
+    return trade_value;
+}
+
+// =======================
+// MARKET / IOC Orders
+// =======================
+
+void MatchingEngine::on_market(const MarketOrderEvent& ev, bool liquidation) {
+    if (state_.book.tick_size == TICK_SIZE)
+        on_sweep<FixedTicks<TICK_SIZE>>(ev, liquidation);
+    else
+        on_sweep<RuntimeTicks>(ev, liquidation);
+}
+
+// Nothing is locked up front: a BUY may spend what its account holds (or
+// its quote_amount, if lower) with the taker fee included, a SELL what
+// base it holds, and each fill is sized to what is left. Every pass of
+// the loop either empties a maker or ends the sweep, so the cost is
+// bounded by the makers taken.
+template <class Ticks>
+void MatchingEngine::on_sweep(const MarketOrderEvent& ev, bool liquidation) {
+    if (ev.instrument != state_.instrument) {
+        emit_report(ExecType::REJECTED, RejectReason::UNKNOWN_INSTRUMENT,
+                    0, ev.account_id, ev.side, 0, ev.quantity);
+        return;
+    }
+
+    Accounts& accts = state_.accounts;
+
+    uint32_t slot = accts.find(ev.account_id);
+    if (slot == NO_ACCOUNT) {
+        emit_report(ExecType::REJECTED, RejectReason::UNKNOWN_ACCOUNT,
+                    0, ev.account_id, ev.side, 0, ev.quantity);
+        return;
+    }
+
+    AccountHot& hot = accts.hot[slot];
+
+    if (hot.state == AccountState::FROZEN && !liquidation) {
+        emit_report(ExecType::REJECTED, RejectReason::ACCOUNT_FROZEN,
+                    0, ev.account_id, ev.side, 0, ev.quantity);
+        return;
+    }
+
+    Orders& orders = state_.orders;
+    OrderBook& book = state_.book;
+
+    if (orders.full()) {
+        emit_report(ExecType::REJECTED, RejectReason::ORDER_CAPACITY,
+                    0, ev.account_id, ev.side, 0, ev.quantity);
+        return;
+    }
+
+    touch_account(slot);
+    touch_account(DUST_SLOT);
+
+    // A quote-only BUY (quantity 0) is bounded by its budget alone
+    bool by_quote = ev.side == BUY && ev.quote_amount > 0;
+    const int64_t wanted = (ev.quantity > 0) ? ev.quantity
+                         : by_quote          ? INT64_MAX
+                                             : 0;
+    int64_t remaining = wanted;
+
+    // Largest notional the taker can still pay for, fee included
+    Balance budget = 0;
+    bool funds_bound = true;
+    if (ev.side == BUY) {
+        Balance cap = hot.quote_available;
+        if (by_quote && Balance{ev.quote_amount} < cap) {
+            cap = ev.quote_amount;
+            funds_bound = false;
+        }
+        budget = cap > 0 ? fee_inclusive_max(cap) : 0;
+    }
+    int64_t base_left = (ev.side == SELL)
+        ? static_cast<int64_t>(std::min<Balance>(hot.base_available,
+                                                 INT64_MAX))
+        : 0;
+
+    uint32_t taker_oid = orders.create(
+        slot,
+        ev.side == BUY ? OrderSide::BUY : OrderSide::SELL,
+        0,
+        remaining,
+        state_.last_sequence
+    );
+    touch_order(taker_oid);
+
+    emit_report(ExecType::ACCEPTED, RejectReason::NONE,
+                orders.cold[taker_oid].id, ev.account_id, ev.side, 0,
+                ev.quantity);
+
+    uint8_t contra_side = (ev.side == BUY) ? SELL : BUY;
+    int32_t& best = (contra_side == BUY) ? book.best_bid : book.best_ask;
+
+    Balance spent_notional = 0;
+    bool out_of_funds = false;
+    bool balance_limit = false;
+
+    while (remaining > 0 && best != -1 && !out_of_funds && !balance_limit) {
+        int32_t idx = best;
+        int64_t price = book.index_to_price<Ticks>(idx);
+
+        PriceLevel* lvl = book.best_level(contra_side);
+        if (!lvl) break;
+
+        while (remaining > 0 && lvl->head) {
+            uint32_t maker_oid = lvl->head;
+            int64_t traded =
+                std::min(remaining, orders.hot[maker_oid].qty_remaining);
+
+            // Cut the fill down to what the taker can still pay for or
+            // deliver; a short fill is the last one
+            if (ev.side == BUY) {
+                Balance room = budget - spent_notional;
+                Balance value;
+                if (!balance_mul(price, traded, value) || value > room) {
+                    traded = static_cast<int64_t>(room / price);
+                    out_of_funds = true;
+                }
+            } else if (traded > base_left) {
+                traded = base_left;
+                out_of_funds = true;
+            }
+
+            if (traded > 0 && !credits_fit(slot, ev.side, maker_oid, price,
+                                           traded, spent_notional)) {
+                balance_limit = true;
+                break;
+            }
+
+            if (traded > 0) {
+                remaining -= traded;
+                if (ev.side == SELL) base_left -= traded;
+                spent_notional += fill_maker(taker_oid, slot, ev.side, *lvl,
+                                             idx, price, maker_oid, traded);
+            }
+            if (out_of_funds) break;
+        }
+    }
+
+    // ----------------------------
+    // TAKER SETTLEMENT + FEE
+    // ----------------------------
+    Balance total_fee = fee_ceiling(spent_notional);
+
+    if (ev.side == BUY) {
+        hot.quote_available -= (spent_notional + total_fee);
+    } else {
+        hot.base_available  -= (wanted - remaining);
+        hot.quote_available -= total_fee;
+    }
+    accts.hot[DUST_SLOT].quote_available += total_fee;
+
+    // Never rests: an unfilled remainder is cancelled. A BUY that ran
+    // through its own quote_amount is complete.
+    orders.hot[taker_oid].qty_remaining = 0;
+
+    bool budget_done =
+        by_quote && out_of_funds && !funds_bound && !balance_limit;
+    if (remaining > 0 && !budget_done) {
+        orders.hot[taker_oid].state = OrderState::CANCELLED;
+        emit_report(ExecType::CANCELLED,
+                    balance_limit  ? RejectReason::BALANCE_LIMIT
+                    : out_of_funds ? RejectReason::INSUFFICIENT_FUNDS
+                                   : RejectReason::NONE,
+                    orders.cold[taker_oid].id, ev.account_id, ev.side, 0,
+                    ev.quantity > 0 ? remaining : 0);
+    } else {
+        orders.hot[taker_oid].state = OrderState::FILLED;
+    }
+    release_order(taker_oid);
 }
 
 // =======================
@@ -329,11 +822,281 @@ void MatchingEngine::on_market(const MarketOrderEvent& ev) {
 // =======================
 
 void MatchingEngine::on_cancel(const CancelEvent& ev) {
-    state_.orders.cancel(ev.order_id);
+    Orders& orders = state_.orders;
+
+    if (ev.instrument != state_.instrument) {
+        emit_report(ExecType::REJECTED, RejectReason::UNKNOWN_INSTRUMENT,
+                    ev.order_id, 0, 0, 0, 0);
+        return;
+    }
+
+    // Ids of filled / cancelled orders, stale generations included
+    uint32_t oid = orders.find(ev.order_id);
+    if (!oid) {
+        emit_report(ExecType::REJECTED, RejectReason::UNKNOWN_ORDER,
+                    ev.order_id, 0, 0, 0, 0);
+        return;
+    }
+
+    cancel_resting(oid);
+}
+
+// Unlinks a LIVE order from its level in O(1) and releases what it still
+// holds locked. Every LIVE order rests in the book.
+void MatchingEngine::cancel_resting(uint32_t oid) {
+    Orders& orders = state_.orders;
+    OrderBook& book = state_.book;
+
+    const OrderHot& h = orders.hot[oid];
+    uint32_t slot = h.account;
+    AccountHot&  hot  = state_.accounts.hot[slot];
+    AccountCold& cold = state_.accounts.cold[slot];
+    uint8_t side = static_cast<uint8_t>(h.side);
+    int64_t price = orders.cold[oid].price;
+    int64_t rem = h.qty_remaining;
+
+    touch_order(oid);
+    touch_account(slot);
+    book_remove(side, book.price_to_index(price), oid);
+
+    if (side == BUY) {
+        Balance& reserved = orders.cold[oid].quote_reserved;
+        cold.quote_locked   -= reserved;
+        hot.quote_available += reserved;
+        reserved = 0;
+    } else {
+        cold.base_locked   -= rem;
+        hot.base_available += rem;
+    }
+
+    orders.cancel(oid);
+
+    emit_report(ExecType::CANCELLED, RejectReason::NONE,
+                orders.cold[oid].id, cold.external_id, side, price, rem);
+    release_order(oid);
+}
+
+void MatchingEngine::release_order(uint32_t oid) {
+    state_.orders.release(oid);
+    touch_order(oid);
+}
+
+// Walks the account's own list, oldest order first, so the cost is the
+// account's resting orders rather than every order ever created
+void MatchingEngine::cancel_account_orders(uint32_t slot) {
+    const AccountCold& cold = state_.accounts.cold[slot];
+    while (cold.order_head)
+        cancel_resting(cold.order_head);
 }
 
 void MatchingEngine::on_time(const TimePulseEvent&) {}
 
-void MatchingEngine::emit_trade(const Trade&) {
-    // append to trade ring buffer (async)
+// =======================
+// Book Mutations
+// =======================
+
+// Resting orders are also kept on their account's list
+void MatchingEngine::book_add(uint8_t side, int32_t idx, uint32_t oid) {
+    Orders& orders = state_.orders;
+    const OrderHot& h = orders.hot[oid];
+    uint32_t slot = h.account;
+    AccountCold& cold = state_.accounts.cold[slot];
+
+    state_.book.add_order(side, idx, oid, orders, pool_);
+    orders.account_append(oid, cold.order_head, cold.order_tail);
+    note_level(side, idx);
+
+    if (!dirty_ && !digest_) return;
+
+    // Level handle (possibly just allocated) and the previous tails
+    touch_level(side, idx);
+    touch_order(oid);
+    touch_account(slot);
+    if (h.prev) touch_order(h.prev);
+    if (h.acct_prev) touch_order(h.acct_prev);
+}
+
+void MatchingEngine::book_remove(uint8_t side, int32_t idx, uint32_t oid) {
+    Orders& orders = state_.orders;
+    const OrderHot& h = orders.hot[oid];
+    uint32_t slot = h.account;
+    AccountCold& cold = state_.accounts.cold[slot];
+
+    // Marked before the unlink, while the neighbours and handle are known
+    if (dirty_ || digest_) {
+        touch_level(side, idx);
+        touch_order(oid);
+        touch_account(slot);
+        if (h.prev) touch_order(h.prev);
+        if (h.next) touch_order(h.next);
+        if (h.acct_prev) touch_order(h.acct_prev);
+        if (h.acct_next) touch_order(h.acct_next);
+    }
+
+    state_.book.remove_order(side, idx, oid, orders, pool_);
+    orders.account_unlink(oid, cold.order_head, cold.order_tail);
+    note_level(side, idx);
+}
+
+// =======================
+// L2 Feed
+// =======================
+
+// A sweep takes makers level by level and a cancel touches one level, so
+// holding back a single change coalesces each run into one update. The
+// level is read when the update goes out, so it carries the final totals.
+void MatchingEngine::note_level(uint8_t side, int32_t idx) {
+    if (!depth_) return;
+
+    int64_t price = state_.book.index_to_price(idx);
+    if (depth_pending_) {
+        if (side == depth_side_ && price == depth_price_) return;
+        flush_level();
+    }
+
+    depth_pending_ = true;
+    depth_side_ = side;
+    depth_price_ = price;
+}
+
+void MatchingEngine::flush_level() {
+    const OrderBook& book = state_.book;
+
+    LevelUpdate u;
+    u.sequence = state_.last_sequence;
+    u.price    = depth_price_;
+    u.quantity = 0;
+    u.orders   = 0;
+    u.side     = depth_side_;
+
+    if (book.indexable(depth_price_)) {
+        const PriceLevel* lvl =
+            book.level(depth_side_, book.price_to_index(depth_price_));
+        if (lvl) {
+            u.quantity = lvl->quantity;
+            u.orders   = lvl->count;
+        }
+    }
+
+    depth_pending_ = false;
+    depth_->publish(u);
+}
+
+// =======================
+// Dirty Marking
+// =======================
+
+void MatchingEngine::touch_order(uint32_t oid) {
+    if (digest_) digest_->touch_order(oid);
+    if (!dirty_) return;
+
+    Orders& o = state_.orders;
+    dirty_->mark(o.hot[oid]);
+    dirty_->mark(o.cold[oid]);
+    dirty_->mark(o.slot_top);
+    dirty_->mark(o.free_head);
+}
+
+void MatchingEngine::touch_account(uint32_t slot) {
+    if (digest_) digest_->touch_account(slot);
+    if (!dirty_) return;
+
+    dirty_->mark(state_.accounts.hot[slot]);
+    dirty_->mark(state_.accounts.cold[slot]);
+}
+
+// The index bucket `account_id` occupies (or would be inserted at)
+void MatchingEngine::touch_account_index(uint64_t account_id) {
+    const Accounts& accts = state_.accounts;
+
+    for (uint32_t i = account_index_hash(account_id);;
+         i = (i + 1) & (ACCOUNT_INDEX_SIZE - 1)) {
+        const AccountIndexEntry& e = accts.index[i];
+        if (e.slot == 0 || e.id == account_id) {
+            dirty_->mark(e);
+            return;
+        }
+    }
+}
+
+// Handle, pool slot, index entries (bitmap words or trie path) and the
+// book's scalar fields
+void MatchingEngine::touch_level(uint8_t side, int32_t idx) {
+    OrderBook& book = state_.book;
+    touch_level_row(book.handle(side, idx));
+
+    if (!dirty_) return;
+
+    if (book.backend == LevelBackend::SPARSE) {
+        book.trie.visit_path(side, idx,
+                             [&](const TrieNode& n) { dirty_->mark(n); });
+        dirty_->mark(book.trie.node_top);
+        dirty_->mark(book.trie.node_free_head);
+        dirty_->mark(book.trie.node_live);
+    } else {
+        uint32_t* levels = (side == BUY) ? book.buy_levels : book.sell_levels;
+        LevelBitmap<MAX_TICKS>& bits = (side == BUY) ? book.buy_bits
+                                                     : book.sell_bits;
+        uint32_t i = static_cast<uint32_t>(idx);
+
+        dirty_->mark(levels[idx]);
+        dirty_->mark(bits.l0[i >> 6]);
+        dirty_->mark(bits.l1[i >> 12]);
+        dirty_->mark(bits.l2);
+    }
+
+    dirty_->mark(book.best_bid);
+    dirty_->mark(book.best_ask);
+    dirty_->mark(book.best_bid_level);
+    dirty_->mark(book.best_ask_level);
+    dirty_->mark(book.level_pool_top);
+    dirty_->mark(book.level_free_head);
+}
+
+void MatchingEngine::touch_level_row(uint32_t h) {
+    if (digest_) digest_->touch_level(h);
+    if (dirty_) dirty_->mark(state_.book.level_pool[h]);
+}
+
+// Reports are appended to the SPSC execution ring; a publisher thread drains
+// it. Nothing here allocates or takes a lock.
+void MatchingEngine::emit_trade(const Trade& t) {
+    if (!reports_) return;
+
+    ExecutionReport r;
+    r.sequence       = state_.last_sequence;
+    r.type           = ExecType::TRADE;
+    r.side           = static_cast<uint8_t>(state_.orders.hot[t.taker].side);
+    r.reason         = RejectReason::NONE;
+    r.order_id       = state_.orders.cold[t.taker].id;
+    r.maker_order_id = state_.orders.cold[t.maker].id;
+    r.account_id     =
+        state_.accounts.cold[state_.orders.hot[t.taker].account].external_id;
+    r.price          = t.price;
+    r.quantity       = t.quantity;
+
+    reports_->publish(r);
+}
+
+void MatchingEngine::emit_report(ExecType type,
+                                 RejectReason reason,
+                                 uint64_t order_id,
+                                 uint64_t account_id,
+                                 uint8_t side,
+                                 int64_t price,
+                                 int64_t quantity) {
+    if (!reports_) return;
+
+    ExecutionReport r;
+    r.sequence       = state_.last_sequence;
+    r.type           = type;
+    r.side           = side;
+    r.reason         = reason;
+    r.order_id       = order_id;
+    r.maker_order_id = 0;
+    r.account_id     = account_id;
+    r.price          = price;
+    r.quantity       = quantity;
+
+    reports_->publish(r);
 }
\ No newline at end of file
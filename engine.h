@@ -1,29 +1,143 @@
 #pragma once
 #include "event.h"
+#include <cstddef>
 #include "engine_state.h"
+#include "execution_ring.h"
+#include "dirty_tracker.h"
+#include "state_digest.h"
+#include "perf.h"
 
+// Orders slots; reports carry their order ids
 struct Trade {
-    uint64_t taker_order_id;
-    uint64_t maker_order_id;
+    uint32_t taker;
+    uint32_t maker;
     int64_t  price;
     int64_t  quantity;
 };
 
 class MatchingEngine {
 public:
-    explicit MatchingEngine(EngineState& state);
+    // `reports` is optional; when null no execution reports are produced.
+    // `dirty`, when set, has every region the engine writes marked in it.
+    // `depth`, when set, gets a LevelUpdate for each level an event
+    // changed, once per run of changes to the same level.
+    // `digest`, when set, is rebuilt from `state` here and kept current
+    // after every event.
+    // `perf`, when set, gets an rdtsc sample per apply() / apply_batch()
+    // and the level pool and recenter counters. It must not be shared
+    // with an engine running on another thread.
+    explicit MatchingEngine(EngineState& state,
+                            ExecutionRing* reports = nullptr,
+                            DirtyTracker* dirty = nullptr,
+                            DepthRing* depth = nullptr,
+                            StateDigest* digest = nullptr,
+                            PerfRing* perf = nullptr);
 
     // THE ONLY ENTRY POINT
     void apply(const EngineEvent& event);
 
+    // Same result as apply() on each of events[0, n) in turn, for callers
+    // that already hold a burst: sequence contiguity is checked once for
+    // the whole batch, the rows the next events will touch are prefetched
+    // while the current one matches, and one rdtsc pair / perf sample
+    // covers the batch.
+    void apply_batch(const EngineEvent* events, size_t n);
+
+    // Hint the cache lines `event` will touch (order row, account index
+    // bucket, price index entry). No state is read or written.
+    void prefetch(const EngineEvent& event) const;
+
+    // Second prefetch stage, for an event whose prefetch() was issued a
+    // few events earlier: follows the (now cached) index entries to the
+    // account rows and price level. Reads state, writes nothing.
+    void prefetch_rows(const EngineEvent& event) const;
+
 private:
-    EngineState& state_;
+    EngineState&   state_;
+    ExecutionRing* reports_;
+    DirtyTracker*  dirty_;
+    DepthRing*     depth_;
+    StateDigest*   digest_;
+    PerfRing*      perf_;
+    LevelPoolCounters* pool_;   // &perf_->level_pool, or null
+
+    // Level with an unpublished change (by price, which survives a
+    // band recenter)
+    bool     depth_pending_ = false;
+    uint8_t  depth_side_ = 0;
+    int64_t  depth_price_ = 0;
+
+    void dispatch(const EngineEvent& event);
 
     void on_new_order(const NewOrderEvent&);
+
+    // Limit order path; Ticks is the book's tick policy (order_book.h)
+    template <class Ticks>
+    void on_limit(const NewOrderEvent&);
+
+    // Slide the band to take a resting price outside it
+    bool recenter_book(int64_t price);
     void on_cancel(const CancelEvent&);
     void on_risk(const RiskControlEvent&);
     void on_time(const TimePulseEvent&);
 
+    void cancel_resting(uint32_t oid);
+
+    // A FILLED / CANCELLED order leaves its slot for the next one
+    void release_order(uint32_t oid);
+
+    // Every resting order of the account (purge, cancel-on-disconnect)
+    void cancel_account_orders(uint32_t slot);
+
+    // Book mutations, with dirty marking
+    void book_add(uint8_t side, int32_t idx, uint32_t oid);
+    void book_remove(uint8_t side, int32_t idx, uint32_t oid);
+
+    // Dirty marking, which also feeds the digest (no-ops without either)
+    void touch_order(uint32_t oid);
+    void touch_account(uint32_t slot);
+    void touch_account_index(uint64_t account_id);
+    void touch_level(uint8_t side, int32_t idx);
+    void touch_level_row(uint32_t h);
+
+    // L2 feed (no-ops without a depth ring): note_level queues a level
+    // change, publishing the queued one first if it is another level;
+    // flush_level publishes it
+    void note_level(uint8_t side, int32_t idx);
+    void flush_level();
+
     void emit_trade(const Trade& t);
-    void on_market(const MarketOrderEvent&);
+    void emit_report(ExecType type,
+                     RejectReason reason,
+                     uint64_t order_id,
+                     uint64_t account_id,
+                     uint8_t side,
+                     int64_t price,
+                     int64_t quantity);
+
+    // Market / IOC path: sweeps the contra side with no price limit,
+    // checking the taker's funds fill by fill, and never rests.
+    // Liquidations run on frozen accounts too.
+    void on_market(const MarketOrderEvent&, bool liquidation = false);
+
+    template <class Ticks>
+    void on_sweep(const MarketOrderEvent&, bool liquidation);
+
+    // Whether the credits of that fill fit in Balance (64-bit builds)
+    bool credits_fit(uint32_t taker_slot,
+                     uint8_t taker_side,
+                     uint32_t maker_oid,
+                     int64_t price,
+                     int64_t traded,
+                     Balance spent_notional) const;
+
+    // One fill against the head maker of a contra level (engine.cpp)
+    Balance fill_maker(uint32_t taker_oid,
+                       uint32_t taker_slot,
+                       uint8_t taker_side,
+                       PriceLevel& lvl,
+                       int32_t idx,
+                       int64_t price,
+                       uint32_t maker_oid,
+                       int64_t traded);
 };
\ No newline at end of file
@@ -2,39 +2,18 @@
 #include <cstdint>
 #include "orders.h"
 #include "order_book.h"
-
-
-
-constexpr uint32_t MAX_ACCOUNTS = 1'000'000;
-
-// Dust account
-constexpr uint64_t DUST_ACCOUNT_ID = 0;
+#include "accounts.h"
 
 // Fees
 constexpr int64_t FEE_NUMERATOR   = 5;
 constexpr int64_t FEE_DENOMINATOR = 10'000;
 
-enum class AccountState : uint8_t {
-    ACTIVE,
-    FROZEN
-};
-
-struct Balance {
-    __int128 available = 0;
-    __int128 locked = 0;
-};
-
-struct Account {
-    AccountState state = AccountState::ACTIVE;
-    Balance base;
-    Balance quote;
-};
-
 struct EngineState {
     uint64_t last_sequence = 0;
     uint64_t last_grc_sequence = 0;
+    uint32_t instrument = 0;
 
-    Account   accounts[MAX_ACCOUNTS];
+    Accounts  accounts;
     Orders    orders;
     OrderBook book;
 };
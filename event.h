@@ -17,21 +17,32 @@ enum class EventType : uint8_t {
 // Order Events
 // =======================
 
+// `instrument` selects the book (ShardedEngine routes on it); a single
+// MatchingEngine only accepts its own state's instrument.
+
 struct NewOrderEvent {
     uint64_t account_id;
     uint8_t  side;      // 0 = BUY, 1 = SELL
+    uint32_t instrument;
     int64_t  price;
     int64_t  quantity;
 };
 
+// Fills against the book until `quantity` lots are done, the book or the
+// taker's funds run out; never rests. A BUY with `quote_amount` > 0 also
+// stops once it has spent that much quote, fee included, and with
+// `quantity` 0 is sized by quote_amount alone. SELLs ignore quote_amount.
 struct MarketOrderEvent {
     uint64_t account_id;
     uint8_t  side;      // 0 = BUY, 1 = SELL
+    uint32_t instrument;
     int64_t  quantity;
+    int64_t  quote_amount;
 };
 
 struct CancelEvent {
-    uint64_t order_id;
+    uint64_t order_id;  // per instrument
+    uint32_t instrument;
 };
 
 // =======================
@@ -44,15 +55,19 @@ enum class RiskCommand : uint8_t {
     LIQUIDATION_MARKET = 3
 };
 
+// FREEZE / PURGE are account-wide (broadcast to every instrument);
+// LIQUIDATION_MARKET targets `instrument`.
 struct RiskControlEvent {
     uint64_t grc_sequence;
     RiskCommand command;
+    uint32_t instrument;
     uint64_t account_id;
     int64_t  quantity;
 };
 
 struct TimePulseEvent {
     uint64_t logical_time;
+    uint32_t instrument;
 };
 
 // =======================
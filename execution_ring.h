@@ -0,0 +1,259 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// =======================
+// Execution Reports
+// =======================
+
+enum class ExecType : uint8_t {
+    TRADE     = 1,
+    ACCEPTED  = 2,
+    CANCELLED = 3,
+    REJECTED  = 4
+};
+
+enum class RejectReason : uint8_t {
+    NONE               = 0,
+    ACCOUNT_FROZEN     = 1,
+    INSUFFICIENT_FUNDS = 2,
+    PRICE_OUT_OF_BAND  = 3,
+    UNKNOWN_ORDER      = 4,
+    UNKNOWN_ACCOUNT    = 5,
+    UNKNOWN_INSTRUMENT = 6,
+    LEVEL_CAPACITY     = 7,   // in band, but no level / trie node left
+    ORDER_CAPACITY     = 8,   // every order slot holds a live order
+    BALANCE_LIMIT      = 9    // a fill would overflow a 64-bit balance
+};
+
+struct ExecutionReport {
+    uint64_t     sequence;        // engine event that produced it
+    ExecType     type;
+    uint8_t      side;            // side of order_id
+    RejectReason reason;
+    uint64_t     order_id;        // taker / subject order
+    uint64_t     maker_order_id;  // TRADE only
+    uint64_t     account_id;      // owner of order_id
+    int64_t      price;
+    int64_t      quantity;        // traded / resting / cancelled qty
+};
+
+// =======================
+// SPSC Ring
+// =======================
+
+constexpr size_t CACHE_LINE = 64;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Single producer / single consumer. Producer and consumer indices live on
+// separate cache lines, each side keeps a private cached copy of the other
+// side's index so the shared line is only read when the cache looks full
+// (producer) or empty (consumer).
+template <typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+public:
+    // ---- producer ----
+    inline bool try_push(const T& v) {
+        const uint64_t h = head_.load(std::memory_order_relaxed);
+        if (h - cached_tail_ >= Capacity) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (h - cached_tail_ >= Capacity)
+                return false;
+        }
+        slots_[h & (Capacity - 1)] = v;
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocks until the consumer advances past `observed_tail`.
+    inline void wait_for_space(uint64_t observed_tail) {
+        tail_.wait(observed_tail, std::memory_order_acquire);
+    }
+
+    inline uint64_t tail() const {
+        return tail_.load(std::memory_order_acquire);
+    }
+
+    // ---- consumer ----
+    inline size_t pop_batch(T* out, size_t max) {
+        const uint64_t t = tail_.load(std::memory_order_relaxed);
+        if (cached_head_ == t) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (cached_head_ == t)
+                return 0;
+        }
+
+        uint64_t avail = cached_head_ - t;
+        size_t n = avail < max ? static_cast<size_t>(avail) : max;
+
+        for (size_t i = 0; i < n; ++i)
+            out[i] = slots_[(t + i) & (Capacity - 1)];
+
+        tail_.store(t + n, std::memory_order_release);
+        tail_.notify_one();
+        return n;
+    }
+
+    inline bool empty() const {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(CACHE_LINE) std::atomic<uint64_t> head_{0};
+    alignas(CACHE_LINE) uint64_t              cached_tail_ = 0;
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail_{0};
+    alignas(CACHE_LINE) uint64_t              cached_head_ = 0;
+    alignas(CACHE_LINE) T                     slots_[Capacity];
+};
+
+// =======================
+// Level Updates
+// =======================
+
+// A price level's new totals after an event changed it; quantity 0 means
+// the level is gone. Absolute rather than deltas, so a consumer that
+// starts from OrderBook::top_levels at sequence S applies the updates
+// with sequence > S and stays exact.
+struct LevelUpdate {
+    uint64_t sequence;   // engine event that changed the level
+    int64_t  price;
+    int64_t  quantity;   // resting quantity left at the level
+    uint32_t orders;     // resting orders left at the level
+    uint8_t  side;
+};
+
+// =======================
+// Publish Rings
+// =======================
+
+enum class Backpressure : uint8_t {
+    SPIN,   // busy-wait on the consumer (lowest latency, burns the core)
+    DROP,   // discard and count (matching never waits)
+    BLOCK   // park on the consumer index until space frees up
+};
+
+// An SpscRing the matching thread publishes into under a Backpressure
+// policy
+template <typename T, uint32_t Capacity>
+struct PublishRing {
+    SpscRing<T, Capacity> ring;
+
+    Backpressure policy = Backpressure::SPIN;
+
+    // Producer-side counters (matching thread only)
+    alignas(CACHE_LINE) uint64_t published = 0;
+    uint64_t dropped = 0;
+    uint64_t full_waits = 0;
+
+    explicit PublishRing(Backpressure p) : policy(p) {}
+
+    inline void publish(const T& r) {
+        if (ring.try_push(r)) {
+            ++published;
+            return;
+        }
+
+        switch (policy) {
+            case Backpressure::DROP:
+                ++dropped;
+                return;
+
+            case Backpressure::SPIN:
+                ++full_waits;
+                do { cpu_relax(); } while (!ring.try_push(r));
+                break;
+
+            case Backpressure::BLOCK:
+                ++full_waits;
+                for (;;) {
+                    uint64_t t = ring.tail();
+                    if (ring.try_push(r)) break;
+                    ring.wait_for_space(t);
+                }
+                break;
+        }
+        ++published;
+    }
+};
+
+constexpr uint32_t EXEC_RING_SIZE  = 1u << 16;
+constexpr uint32_t DEPTH_RING_SIZE = 1u << 16;
+
+using ExecutionRing = PublishRing<ExecutionReport, EXEC_RING_SIZE>;
+using DepthRing     = PublishRing<LevelUpdate, DEPTH_RING_SIZE>;
+
+// =======================
+// Publisher Thread
+// =======================
+
+using ExecutionHandler =
+    void (*)(const ExecutionReport* batch, size_t n, void* ctx);
+
+constexpr size_t EXEC_PUBLISH_BATCH = 256;
+
+// Drains an ExecutionRing on its own thread and hands reports to `handler`
+// in batches of up to EXEC_PUBLISH_BATCH.
+class ExecutionPublisher {
+public:
+    ExecutionPublisher(ExecutionRing& ring,
+                       ExecutionHandler handler,
+                       void* ctx)
+        : ring_(ring), handler_(handler), ctx_(ctx) {}
+
+    ~ExecutionPublisher() { stop(); }
+
+    void start() {
+        running_.store(true, std::memory_order_relaxed);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    // Drains whatever is left in the ring before returning.
+    void stop() {
+        if (!thread_.joinable()) return;
+        running_.store(false, std::memory_order_release);
+        thread_.join();
+    }
+
+    uint64_t consumed() const {
+        return consumed_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() {
+        ExecutionReport batch[EXEC_PUBLISH_BATCH];
+
+        for (;;) {
+            bool live = running_.load(std::memory_order_acquire);
+            size_t n = ring_.ring.pop_batch(batch, EXEC_PUBLISH_BATCH);
+
+            if (n) {
+                if (handler_) handler_(batch, n, ctx_);
+                consumed_.fetch_add(n, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (!live) break;
+            cpu_relax();
+        }
+    }
+
+    ExecutionRing&        ring_;
+    ExecutionHandler      handler_;
+    void*                 ctx_;
+    std::atomic<bool>     running_{false};
+    std::atomic<uint64_t> consumed_{0};
+    std::thread           thread_;
+};
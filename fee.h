@@ -0,0 +1,95 @@
+#pragma once
+#include "engine_state.h"
+#include <cstdint>   // INT64_MAX
+
+// =======================
+// Fee Arithmetic
+// =======================
+//
+// fee_ceiling(v) = ceil(v * FEE_NUMERATOR / FEE_DENOMINATOR), the fee on
+// a notional of v. It runs on every buy lock and every fill, so values
+// that fit in 63 bits (all of them, for realistic notionals) divide by a
+// precomputed reciprocal: one 64 x 64 -> 128 multiply and a shift. A
+// 128-bit divide is a libcall costing tens of cycles. Anything else
+// takes the plain formula, so results match it everywhere.
+
+constexpr int64_t fee_gcd(int64_t a, int64_t b) {
+    return b == 0 ? a : fee_gcd(b, a % b);
+}
+
+constexpr uint64_t FEE_NUM = static_cast<uint64_t>(
+    FEE_NUMERATOR / fee_gcd(FEE_NUMERATOR, FEE_DENOMINATOR));
+constexpr uint64_t FEE_DEN = static_cast<uint64_t>(
+    FEE_DENOMINATOR / fee_gcd(FEE_NUMERATOR, FEE_DENOMINATOR));
+
+// floor(u / d) for any u < 2^63, as (u * magic) >> shift with
+// magic = ceil(2^(63 + l) / d), l = ceil(log2 d) (Granlund-Montgomery)
+struct Reciprocal {
+    uint64_t magic;
+    uint32_t shift;
+
+    constexpr explicit Reciprocal(uint64_t d) : magic(0), shift(0) {
+        uint32_t l = 0;
+        while ((1ull << l) < d) ++l;
+        shift = 63 + l;
+        unsigned __int128 p = static_cast<unsigned __int128>(1) << shift;
+        magic = static_cast<uint64_t>((p + d - 1) / d);
+    }
+
+    inline constexpr uint64_t div(uint64_t u) const {
+        return static_cast<uint64_t>(
+            (static_cast<unsigned __int128>(u) * magic) >> shift);
+    }
+};
+
+constexpr Reciprocal FEE_RECIPROCAL{FEE_DEN};
+
+// The remainder term below must stay in the reciprocal's range
+static_assert(FEE_NUM <= FEE_DEN && FEE_DEN < (1ull << 31),
+              "fee ratio out of range");
+static_assert(FEE_RECIPROCAL.div(FEE_DEN - 1) == 0 &&
+              FEE_RECIPROCAL.div(FEE_DEN) == 1 &&
+              FEE_RECIPROCAL.div((1ull << 63) - 1) ==
+                  ((1ull << 63) - 1) / FEE_DEN,
+              "fee reciprocal");
+
+// Plain formula, for reference and out-of-range values
+template <class T>
+inline T fee_ceiling_div(T value) {
+    return (value * FEE_NUMERATOR + FEE_DENOMINATOR - 1) / FEE_DENOMINATOR;
+}
+
+// Largest v for which v * FEE_NUM + FEE_DEN - 1 stays below 2^63
+constexpr uint64_t FEE_ONE_STEP_MAX = ((1ull << 63) - FEE_DEN) / FEE_NUM;
+
+template <class T>
+inline T fee_ceiling(T value) {
+    bool fast = value >= 0;
+    if constexpr (sizeof(T) > sizeof(int64_t))
+        fast = fast && value <= T{INT64_MAX};
+
+    if (!fast) {
+        // Wide enough that value * FEE_NUMERATOR cannot wrap
+        return static_cast<T>(fee_ceiling_div(static_cast<__int128>(value)));
+    }
+
+    uint64_t u = static_cast<uint64_t>(value);
+    if (u <= FEE_ONE_STEP_MAX)
+        return static_cast<T>(FEE_RECIPROCAL.div(u * FEE_NUM + FEE_DEN - 1));
+
+    // u = q * FEE_DEN + r: fee = q * FEE_NUM + ceil(r * FEE_NUM / FEE_DEN)
+    uint64_t q = FEE_RECIPROCAL.div(u);
+    uint64_t r = u - q * FEE_DEN;
+    return static_cast<T>(q * FEE_NUM +
+                          FEE_RECIPROCAL.div(r * FEE_NUM + FEE_DEN - 1));
+}
+
+// Largest notional n with n + fee_ceiling(n) <= budget (budget >= 0):
+// n = floor(budget * DEN / (DEN + NUM)) always fits, as the fee's
+// rounding adds less than one, and n + 1 never does. Once per market
+// order, so the wide divide is fine.
+template <class T>
+inline T fee_inclusive_max(T budget) {
+    return static_cast<T>(static_cast<__int128>(budget) * FEE_DEN /
+                          (FEE_DEN + FEE_NUM));
+}
@@ -0,0 +1,147 @@
+#include "engine.h"
+#include "fee.h"
+#include "instruments.h"
+#include "invariants.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// ------------------------------------------------------------
+// Balance width (built twice, as fill_bench_128 and fill_bench_64):
+//   1. fee_ceiling: plain division vs reciprocal, 64 and 128 bits
+//   2. cycles per fill: resting BUY makers swept by SELL takers, so
+//      every fill settles a maker lock, a maker fee and the taker fee
+// ------------------------------------------------------------
+
+constexpr uint32_t FEE_CALLS = 20'000'000;
+constexpr uint64_t ACCOUNTS = 100'000;
+constexpr uint64_t MAKERS = 1'000'000;
+constexpr int64_t  SWEEP_QTY = 1000;
+constexpr int64_t  LEVELS = 64;
+
+static inline uint64_t rdtsc() {
+#if defined(__x86_64__) || defined(_M_X64)
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return 0;
+#endif
+}
+
+template <class T, T (*Fee)(T)>
+static double cycles_per_fee(const std::vector<int64_t>& values, T& checksum) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < FEE_CALLS; ++i)
+        checksum += Fee(static_cast<T>(values[i & 4095]));
+    uint64_t end = rdtsc();
+    return static_cast<double>(end - start) / FEE_CALLS;
+}
+
+static void bench_fee() {
+    // Notionals of a few thousand up to ~10^13
+    std::mt19937_64 rng(5);
+    std::vector<int64_t> values(4096);
+    for (auto& v : values)
+        v = static_cast<int64_t>(rng() >> (rng() % 30 + 21));
+
+    int64_t  sum64_div = 0, sum64_rcp = 0;
+    __int128 sum128_div = 0, sum128_rcp = 0;
+
+    double d64 =
+        cycles_per_fee<int64_t, fee_ceiling_div<int64_t>>(values, sum64_div);
+    double r64 =
+        cycles_per_fee<int64_t, fee_ceiling<int64_t>>(values, sum64_rcp);
+    double d128 =
+        cycles_per_fee<__int128, fee_ceiling_div<__int128>>(values, sum128_div);
+    double r128 =
+        cycles_per_fee<__int128, fee_ceiling<__int128>>(values, sum128_rcp);
+
+    if (sum64_div != sum64_rcp || sum128_div != sum128_rcp ||
+        sum128_div != sum64_div) {
+        std::fprintf(stderr, "fee mismatch\n");
+        std::abort();
+    }
+
+    std::printf("[fee_ceiling] cycles/call\n");
+    std::printf("  64-bit:  division %5.2f  reciprocal %5.2f\n", d64, r64);
+    std::printf("  128-bit: division %5.2f  reciprocal %5.2f\n", d128, r128);
+}
+
+// One maker per account in turn, each BUY 1 @ one of LEVELS prices; SELL
+// takers at the bottom price then sweep SWEEP_QTY fills apiece. Enough
+// accounts that their rows fall out of cache, where narrow rows pay off.
+static double cycles_per_fill() {
+    auto* state =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    init_instrument(*state, DEFAULT_INSTRUMENT);
+    MatchingEngine engine(*state);
+
+    const Balance funds = 1'000'000'000'000;
+    for (uint64_t a = 0; a < ACCOUNTS; ++a) {
+        uint32_t slot = state->accounts.open(a);
+        state->accounts.hot[slot].base_available  = funds;
+        state->accounts.hot[slot].quote_available = funds;
+    }
+
+    const int64_t base = DEFAULT_INSTRUMENT.min_price;
+    uint64_t seq = 0;
+
+    std::vector<EngineEvent> makers(MAKERS);
+    for (uint64_t i = 0; i < MAKERS; ++i) {
+        EngineEvent& ev = makers[i];
+        ev = EngineEvent{};
+        ev.header.sequence = ++seq;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = i % ACCOUNTS;
+        ev.new_order.side       = BUY;
+        ev.new_order.price      = base + static_cast<int64_t>(i % LEVELS);
+        ev.new_order.quantity   = 1;
+    }
+    engine.apply_batch(makers.data(), makers.size());
+
+    std::vector<EngineEvent> takers(MAKERS / SWEEP_QTY);
+    for (uint64_t i = 0; i < takers.size(); ++i) {
+        EngineEvent& ev = takers[i];
+        ev = EngineEvent{};
+        ev.header.sequence = ++seq;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = i % ACCOUNTS;
+        ev.new_order.side       = SELL;
+        ev.new_order.price      = base;
+        ev.new_order.quantity   = SWEEP_QTY;
+    }
+
+    uint64_t start = rdtsc();
+    engine.apply_batch(takers.data(), takers.size());
+    uint64_t end = rdtsc();
+
+    if (state->book.best_bid != -1) {
+        std::fprintf(stderr, "sweep left makers resting\n");
+        std::abort();
+    }
+    InvariantChecker::check_book(*state);
+    InvariantChecker::check_balances(*state,
+                                     __int128{funds} * ACCOUNTS,
+                                     __int128{funds} * ACCOUNTS);
+
+    std::free(state);
+    return static_cast<double>(end - start) / MAKERS;
+}
+
+int main() {
+    std::printf("balance width %d bits, AccountHot %zu bytes,"
+                " AccountCold %zu bytes\n",
+                ENGINE_BALANCE_BITS, sizeof(AccountHot), sizeof(AccountCold));
+
+    bench_fee();
+
+    double best = 1e300;
+    for (int round = 0; round < 3; ++round)
+        best = std::min(best, cycles_per_fill());
+    std::printf("[fill] %.1f cycles/fill (%llu fills)\n", best,
+                static_cast<unsigned long long>(MAKERS));
+}
@@ -1,15 +1,24 @@
 #include "engine.h"
 #include "invariants.h"
 #include "engine_state.h"
+#include "fee.h"
+#include "journal.h"
+#include "instruments.h"
+#include "perf.h"
 
+#include <algorithm>
+#include <map>
 #include <random>
-#include <vector>
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <vector>
 
 constexpr uint64_t TEST_ACCOUNTS = 1000;
 constexpr __int128 INITIAL_BALANCE = 1'000'000'000;
+constexpr uint64_t FUZZ_EVENTS = 500'000;
+constexpr uint64_t DIGEST_EVERY = 1024;
+constexpr const char* JOURNAL_DIR = "fuzz_journal.d";
 
 // ------------------------------------------------------------
 // Local fee helper (must match engine.cpp exactly)
@@ -31,11 +40,10 @@ static void assert_deterministic_equal(const EngineState& a,
         std::abort();
     }
 
-    if (a.orders.next_order_id != b.orders.next_order_id) {
+    if (a.orders.slot_top != b.orders.slot_top) {
         std::fprintf(stderr,
-            "Mismatch: next_order_id %llu vs %llu\n",
-            (unsigned long long)a.orders.next_order_id,
-            (unsigned long long)b.orders.next_order_id);
+            "Mismatch: order slot_top %u vs %u\n",
+            a.orders.slot_top, b.orders.slot_top);
         std::abort();
     }
 
@@ -44,7 +52,7 @@ static void assert_deterministic_equal(const EngineState& a,
         std::abort();
     }
 
-    if (std::memcmp(&a.accounts, &b.accounts, sizeof(a.accounts)) != 0) {
+    if (!a.accounts.logical_equals(b.accounts)) {
         std::fprintf(stderr, "Mismatch: accounts\n");
         std::abort();
     }
@@ -55,85 +63,933 @@ static void assert_deterministic_equal(const EngineState& a,
     }
 }
 
+static void seed_accounts(EngineState& s) {
+    for (uint64_t i = 0; i < TEST_ACCOUNTS; ++i) {
+        uint32_t slot = s.accounts.open(i);
+        s.accounts.hot[slot].base_available  = INITIAL_BALANCE;
+        s.accounts.hot[slot].quote_available = INITIAL_BALANCE;
+    }
+}
+
+// Current id of a random slot, live or not; one in eight is the id the
+// slot held a generation earlier, which a cancel must refuse as stale
+static uint64_t random_order_id(const Orders& o, std::mt19937_64& rng) {
+    uint64_t id = o.cold[1 + rng() % (o.slot_top - 1)].id;
+    if (rng() % 8 == 0 && id >= ORDER_GENERATION) id -= ORDER_GENERATION;
+    return id;
+}
+
+// Releases what resting BUY orders hold locked, as a final cancel would
+static void refund_resting_buys(EngineState& s) {
+    for (uint32_t oid = 1; oid < s.orders.slot_top; ++oid) {
+        if (s.orders.hot[oid].state != OrderState::LIVE)
+            continue;
+
+        if (s.orders.hot[oid].side != OrderSide::BUY)
+            continue;
+
+        int64_t rem = s.orders.hot[oid].qty_remaining;
+        if (rem <= 0)
+            continue;
+
+        uint32_t slot = s.orders.hot[oid].account;
+        Balance lock = s.orders.cold[oid].quote_reserved;
+
+        s.accounts.cold[slot].quote_locked    -= lock;
+        s.accounts.hot[slot].quote_available  += lock;
+
+        s.orders.hot[oid].state = OrderState::CANCELLED;
+    }
+}
+
+// The running digest must equal one rebuilt from the state as it stands
+static void check_digest(const StateDigest& running, const EngineState& s) {
+    StateDigest fresh;
+    fresh.rebuild(s);
+    if (running.value(s) != fresh.value(s)) {
+        std::fprintf(stderr, "Digest drifted from the state at %llu\n",
+                     (unsigned long long)s.last_sequence);
+        std::abort();
+    }
+}
+
+// ------------------------------------------------------------
+// Reciprocal fee path against the plain division, both widths
+// ------------------------------------------------------------
+static void check_fee(int64_t v) {
+    __int128 expect = fee_ceiling_local(v);
+    if (fee_ceiling<int64_t>(v) != static_cast<int64_t>(expect) ||
+        fee_ceiling<__int128>(v) != expect) {
+        std::fprintf(stderr, "Mismatch: fee at %lld\n",
+                     static_cast<long long>(v));
+        std::abort();
+    }
+}
+
+static void fuzz_fee_reciprocal() {
+    for (int64_t v = 0; v < 4 * FEE_DENOMINATOR; ++v)
+        check_fee(v);
+
+    for (int b = 1; b < 63; ++b) {
+        int64_t p = int64_t{1} << b;
+        check_fee(p - 1);
+        check_fee(p);
+        check_fee(p + 1);
+    }
+    check_fee(INT64_MAX / FEE_NUMERATOR);
+    check_fee(INT64_MAX);
+
+    std::mt19937_64 rng(2024);
+    for (int i = 0; i < 1'000'000; ++i) {
+        int64_t v = static_cast<int64_t>(rng() >> (rng() % 40 + 1));
+        check_fee(v % (INT64_MAX / FEE_NUMERATOR));
+    }
+
+    // Budget -> largest affordable notional, against its definition
+    for (int i = 0; i < 100'000; ++i) {
+        int64_t budget = static_cast<int64_t>(rng() >> (rng() % 40 + 1));
+        __int128 n = fee_inclusive_max<__int128>(budget);
+        if (n + fee_ceiling_local(n) > budget ||
+            n + 1 + fee_ceiling_local(n + 1) <= budget) {
+            std::fprintf(stderr, "Mismatch: fee_inclusive_max at %lld\n",
+                         static_cast<long long>(budget));
+            std::abort();
+        }
+    }
+
+    // Past 63 bits only the wide type takes the division path
+    __int128 wide = (__int128)INT64_MAX * 1000 + 7;
+    if (fee_ceiling(wide) != fee_ceiling_local(wide)) {
+        std::fprintf(stderr, "Mismatch: fee past 63 bits\n");
+        std::abort();
+    }
+}
+
+// ------------------------------------------------------------
+// Market / IOC orders and liquidations: funds never go negative, quote
+// budgets hold, nothing rests and supply is conserved
+// ------------------------------------------------------------
+static uint64_t resting_of(const EngineState& s, uint32_t slot) {
+    uint64_t n = 0;
+    for (uint32_t oid = s.accounts.cold[slot].order_head; oid;
+         oid = s.orders.hot[oid].acct_next)
+        ++n;
+    return n;
+}
+
+static EngineEvent market_event(uint64_t seq, uint64_t account, uint8_t side,
+                                int64_t quantity, int64_t quote_amount) {
+    EngineEvent ev{};
+    ev.header.sequence = seq;
+    ev.header.type = EventType::MARKET_ORDER;
+    ev.market.account_id   = account;
+    ev.market.side         = side;
+    ev.market.quantity     = quantity;
+    ev.market.quote_amount = quote_amount;
+    return ev;
+}
+
+static void fuzz_market_orders() {
+    auto* state = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    StateDigest digest;
+    MatchingEngine engine(*state, nullptr, nullptr, nullptr, &digest);
+    seed_accounts(*state);
+    digest.rebuild(*state);
+    Accounts& accts = state->accounts;
+
+    uint64_t seq = 0;
+    auto limit = [&](uint64_t account, uint8_t side, int64_t price,
+                     int64_t quantity) {
+        EngineEvent ev{};
+        ev.header.sequence = ++seq;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = account;
+        ev.new_order.side       = side;
+        ev.new_order.price      = price;
+        ev.new_order.quantity   = quantity;
+        engine.apply(ev);
+    };
+
+    // A market BUY used to lock INT64_MAX * quantity and do nothing
+    const int64_t px = 1'000'100;
+    const uint32_t buyer = accts.find(2);
+    limit(1, SELL, px, 10);
+    engine.apply(market_event(++seq, 2, BUY, 5, 0));
+    int64_t three_lots = px * 3 + fee_ceiling<int64_t>(px * 3);
+    engine.apply(market_event(++seq, 2, BUY, 0, three_lots));
+    engine.apply(market_event(++seq, 2, BUY, 100, 0));
+
+    if (accts.hot[buyer].base_available != INITIAL_BALANCE + 10 ||
+        state->book.best_ask != -1 || resting_of(*state, buyer) != 0) {
+        std::fprintf(stderr, "Market BUY did not fill as sized\n");
+        std::abort();
+    }
+
+    std::mt19937_64 rng(1357);
+    uint64_t grc = 0;
+
+    for (int i = 0; i < 200'000; ++i) {
+        uint64_t account = rng() % TEST_ACCOUNTS;
+        uint32_t slot = accts.find(account);
+        uint64_t pick = rng() % 100;
+
+        if (pick < 70) {
+            limit(account, static_cast<uint8_t>(rng() % 2),
+                  1'000'000 + static_cast<int64_t>(rng() % 1000),
+                  static_cast<int64_t>(rng() % 10) + 1);
+            continue;
+        }
+
+        Balance quote_before = accts.hot[slot].quote_available;
+        Balance base_held = accts.hot[slot].base_available +
+                            accts.cold[slot].base_locked;
+        uint64_t resting = resting_of(*state, slot);
+
+        if (pick < 99) {
+            uint8_t side = pick < 90 ? BUY : SELL;
+            int64_t qty = static_cast<int64_t>(rng() % 60);
+            int64_t quote = (side == BUY && pick < 80)
+                ? static_cast<int64_t>(rng() % 50'000'000) : 0;
+            engine.apply(market_event(++seq, account, side, qty, quote));
+
+            if (quote > 0 &&
+                quote_before - accts.hot[slot].quote_available > quote) {
+                std::fprintf(stderr, "Market BUY spent past quote_amount\n");
+                std::abort();
+            }
+            if (resting_of(*state, slot) > resting) {
+                std::fprintf(stderr, "Market order rested\n");
+                std::abort();
+            }
+        } else {
+            // Freeze, then liquidate: the account's orders are cancelled
+            // and its base sold into the bids
+            int64_t qty = static_cast<int64_t>(rng() % 100) + 1;
+            EngineEvent ev{};
+            ev.header.type = EventType::RISK_CONTROL;
+            ev.risk.account_id = account;
+            ev.risk.quantity = qty;
+            for (RiskCommand c : {RiskCommand::ACCOUNT_FREEZE,
+                                  RiskCommand::LIQUIDATION_MARKET}) {
+                ev.header.sequence = ++seq;
+                ev.risk.grc_sequence = ++grc;
+                ev.risk.command = c;
+                engine.apply(ev);
+            }
+
+            Balance sold = base_held - accts.hot[slot].base_available;
+            if (resting_of(*state, slot) != 0 ||
+                accts.cold[slot].base_locked != 0 ||
+                (base_held > 0 && sold != std::min<Balance>(qty, base_held) &&
+                 state->book.best_bid != -1)) {
+                std::fprintf(stderr, "Liquidation of %llu incomplete\n",
+                             (unsigned long long)account);
+                std::abort();
+            }
+        }
+
+        if (accts.hot[slot].quote_available < 0 ||
+            accts.hot[slot].base_available < 0) {
+            std::fprintf(stderr, "Market order overdrew %llu\n",
+                         (unsigned long long)account);
+            std::abort();
+        }
+
+        if (i % 20'000 == 0) {
+            InvariantChecker::check_book(*state);
+            InvariantChecker::check_locks(*state);
+            check_digest(digest, *state);
+        }
+    }
+
+    InvariantChecker::check_book(*state);
+    InvariantChecker::check_locks(*state);
+    check_digest(digest, *state);
+    refund_resting_buys(*state);
+    InvariantChecker::check_balances(
+        *state,
+        INITIAL_BALANCE * TEST_ACCOUNTS,
+        INITIAL_BALANCE * TEST_ACCOUNTS
+    );
+
+    std::free(state);
+}
+
+// ------------------------------------------------------------
+// Ceiling fees are not additive: fee(2p) can be a unit short of twice
+// fee(p). A partly filled BUY that rests, and a resting BUY filled one
+// lot at a time, must still release exactly what they locked.
+// ------------------------------------------------------------
+static void fuzz_fee_rounding_locks() {
+    auto* state = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    MatchingEngine engine(*state);
+    seed_accounts(*state);
+    Accounts& accts = state->accounts;
+
+    const int64_t px = 1'000'001;   // fee(px) = 501, fee(2 * px) = 1001
+    uint64_t seq = 0;
+    auto limit = [&](uint64_t account, uint8_t side, int64_t quantity) {
+        EngineEvent ev{};
+        ev.header.sequence = ++seq;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = account;
+        ev.new_order.side       = side;
+        ev.new_order.price      = px;
+        ev.new_order.quantity   = quantity;
+        engine.apply(ev);
+        InvariantChecker::check_locks(*state);
+    };
+
+    // Taker fills one lot, rests one, then cancels it
+    limit(1, SELL, 1);
+    limit(2, BUY, 2);
+    uint32_t rested = accts.cold[accts.find(2)].order_head;
+    EngineEvent cancel{};
+    cancel.header.sequence = ++seq;
+    cancel.header.type = EventType::CANCEL;
+    cancel.cancel.order_id = state->orders.cold[rested].id;
+    engine.apply(cancel);
+    InvariantChecker::check_locks(*state);
+
+    // A resting 2-lot BUY filled by two 1-lot SELLs
+    limit(3, BUY, 2);
+    limit(4, SELL, 1);
+    limit(4, SELL, 1);
+
+    const uint32_t slots[] = {accts.find(2), accts.find(3)};
+    for (uint32_t slot : slots) {
+        if (accts.cold[slot].quote_locked != 0 ||
+            accts.cold[slot].order_head != 0) {
+            std::fprintf(stderr, "Fee rounding left a lock behind\n");
+            std::abort();
+        }
+    }
+
+    InvariantChecker::check_book(*state);
+    InvariantChecker::check_balances(
+        *state,
+        INITIAL_BALANCE * TEST_ACCOUNTS,
+        INITIAL_BALANCE * TEST_ACCOUNTS
+    );
+
+    std::free(state);
+}
+
+// ------------------------------------------------------------
+// Settlement credits that would overflow a 64-bit balance: the taker
+// stops short of that maker, nothing crossing rests, and the maker is
+// untouched. 128-bit balances take the same fills.
+// ------------------------------------------------------------
+static void fuzz_balance_limit() {
+    auto* state = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    MatchingEngine engine(*state);
+    seed_accounts(*state);
+    Accounts& accts = state->accounts;
+
+    constexpr bool narrow = sizeof(Balance) == sizeof(int64_t);
+    const int64_t px = 1'000'000;
+    uint64_t seq = 0;
+    auto limit = [&](uint64_t account, uint8_t side, int64_t price) {
+        EngineEvent ev{};
+        ev.header.sequence = ++seq;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = account;
+        ev.new_order.side       = side;
+        ev.new_order.price      = price;
+        ev.new_order.quantity   = 1;
+        engine.apply(ev);
+    };
+
+    // Seller 1 is a few units short of INT64_MAX in quote, buyer 3 at
+    // it in base; one lot tips either over
+    const uint32_t seller = accts.find(1);
+    const uint32_t buyer  = accts.find(3);
+    accts.hot[seller].quote_available = Balance{INT64_MAX} - 10;
+    accts.hot[buyer].base_available   = Balance{INT64_MAX};
+
+    limit(2, BUY, px);
+    limit(4, SELL, px + TICK_SIZE);
+    limit(1, SELL, px);
+    engine.apply(market_event(++seq, 3, BUY, 1, 0));
+
+    const uint32_t makers[] = {accts.find(2), accts.find(4)};
+    for (uint32_t maker : makers) {
+        if ((accts.cold[maker].order_head != 0) != narrow) {
+            std::fprintf(stderr, "Balance limit: maker %s\n",
+                         narrow ? "filled" : "left resting");
+            std::abort();
+        }
+    }
+    if (accts.cold[seller].order_head != 0 ||
+        accts.cold[buyer].order_head != 0 ||
+        (narrow && (accts.hot[seller].base_available != INITIAL_BALANCE ||
+                    accts.hot[buyer].quote_available != INITIAL_BALANCE))) {
+        std::fprintf(stderr, "Balance limit: taker settled or rested\n");
+        std::abort();
+    }
+
+    InvariantChecker::check_book(*state);
+    InvariantChecker::check_locks(*state);
+    std::free(state);
+}
+
+// ------------------------------------------------------------
+// Every slot but the dust account's can be opened, the next new id is
+// refused, and a rebuilt index still finds them all
+// ------------------------------------------------------------
+static void fuzz_account_capacity() {
+    auto* state = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    Accounts& accts = state->accounts;
+
+    auto fail = [](const char* what, uint64_t id) {
+        std::fprintf(stderr, "Account capacity: %s %llu\n", what,
+                     (unsigned long long)id);
+        std::abort();
+    };
+
+    for (uint64_t id = 1; id < MAX_ACCOUNTS; ++id) {
+        if (accts.open(id) != id) fail("open", id);
+    }
+    if (accts.count != MAX_ACCOUNTS - 1) fail("count", accts.count);
+
+    if (accts.open(MAX_ACCOUNTS) != NO_ACCOUNT) fail("overfilled", 0);
+    if (accts.open(MAX_ACCOUNTS - 1) != MAX_ACCOUNTS - 1)
+        fail("reopen", MAX_ACCOUNTS - 1);
+    if (accts.open(DUST_ACCOUNT_ID) != DUST_SLOT) fail("dust", 0);
+
+    accts.reindex();
+    for (uint64_t id = 1; id < MAX_ACCOUNTS; ++id) {
+        if (accts.find(id) != id) fail("find", id);
+    }
+    if (accts.find(MAX_ACCOUNTS) != NO_ACCOUNT) fail("phantom", 0);
+
+    std::free(state);
+}
+
+// ------------------------------------------------------------
+// Runtime tick and a narrow band that follows a drifting market
+// ------------------------------------------------------------
+static void fuzz_drifting_band() {
+    constexpr int64_t TICK = 5;
+    constexpr InstrumentSpec SPEC{
+        0, TICK, 1'000'000, 1'000'000 + 256 * TICK, true,
+        LevelBackend::DENSE};
+
+    auto* state = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    init_instrument(*state, SPEC);
+    StateDigest digest;
+    auto* perf = new PerfRing;
+    MatchingEngine engine(*state, nullptr, nullptr, nullptr, &digest, perf);
+    seed_accounts(*state);
+    digest.rebuild(*state);
+
+    std::mt19937_64 rng(9876);
+    int64_t mid = 1'000'000 + 128 * TICK;
+
+    for (uint64_t i = 1; i <= 200'000; ++i) {
+        EngineEvent ev{};
+        ev.header.sequence = i;
+
+        if (state->orders.slot_top > 1 && rng() % 3 == 0) {
+            ev.header.type = EventType::CANCEL;
+            ev.cancel.order_id = random_order_id(state->orders, rng);
+        } else {
+            // Random walk well past the band; one in 16 orders off-grid
+            mid += (static_cast<int64_t>(rng() % 3) - 1) * TICK;
+            if (mid < 1'000 * TICK) mid = 1'000 * TICK;
+
+            ev.header.type = EventType::NEW_ORDER;
+            ev.new_order.account_id = rng() % TEST_ACCOUNTS;
+            ev.new_order.side       = static_cast<uint8_t>(rng() % 2);
+            ev.new_order.price      =
+                mid + (static_cast<int64_t>(rng() % 64) - 32) * TICK +
+                (rng() % 16 == 0 ? 1 : 0);
+            ev.new_order.quantity   = static_cast<int64_t>(rng() % 10) + 1;
+        }
+
+        engine.apply(ev);
+
+        if (i % 20'000 == 0) {
+            InvariantChecker::check_book(*state);
+            InvariantChecker::check_locks(*state);
+            check_digest(digest, *state);
+        }
+    }
+
+    InvariantChecker::check_book(*state);
+    InvariantChecker::check_locks(*state);
+    check_digest(digest, *state);
+
+    // Resting orders all sit on the tick grid
+    for (uint32_t oid = 1; oid < state->orders.slot_top; ++oid) {
+        const Orders& o = state->orders;
+        if (o.hot[oid].state == OrderState::LIVE &&
+            (o.cold[oid].price - state->book.min_price) % TICK != 0)
+            std::abort();
+    }
+
+    if (perf->band_recenters == 0) {
+        std::fprintf(stderr, "Drifting band never recentred\n");
+        std::abort();
+    }
+
+    refund_resting_buys(*state);
+    InvariantChecker::check_balances(
+        *state,
+        INITIAL_BALANCE * TEST_ACCOUNTS,
+        INITIAL_BALANCE * TEST_ACCOUNTS
+    );
+
+    delete perf;
+    std::free(state);
+}
+
+// ------------------------------------------------------------
+// SPARSE vs DENSE: the same flow inside the dense band must leave both
+// books logically identical; then a band far wider than MAX_TICKS
+// ------------------------------------------------------------
+static void fuzz_sparse_levels() {
+    constexpr InstrumentSpec DENSE{
+        0, TICK_SIZE, 1'000'000, 1'000'000 + MAX_TICKS * TICK_SIZE, false,
+        LevelBackend::DENSE};
+    constexpr InstrumentSpec SPARSE{
+        0, TICK_SIZE, 1'000'000, 1'000'000 + TRIE_KEYS * int64_t{TICK_SIZE},
+        false, LevelBackend::SPARSE};
+
+    auto* dense = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    auto* sparse = static_cast<EngineState*>(
+        std::calloc(1, sizeof(EngineState)));
+    init_instrument(*dense, DENSE);
+    init_instrument(*sparse, SPARSE);
+    MatchingEngine dense_engine(*dense);
+    MatchingEngine sparse_engine(*sparse);
+    seed_accounts(*dense);
+    seed_accounts(*sparse);
+
+    std::mt19937_64 rng(2468);
+    uint64_t seq = 0;
+
+    auto random_order = [&](EngineEvent& ev, int64_t lo, int64_t width) {
+        ev = EngineEvent{};
+        ev.header.sequence = ++seq;
+
+        if (sparse->orders.slot_top > 1 && rng() % 4 == 0) {
+            ev.header.type = EventType::CANCEL;
+            ev.cancel.order_id = random_order_id(sparse->orders, rng);
+        } else {
+            ev.header.type = EventType::NEW_ORDER;
+            ev.new_order.account_id = rng() % TEST_ACCOUNTS;
+            ev.new_order.side       = static_cast<uint8_t>(rng() % 2);
+            ev.new_order.price      =
+                lo + static_cast<int64_t>(rng() % static_cast<uint64_t>(width));
+            ev.new_order.quantity   = static_cast<int64_t>(rng() % 10) + 1;
+        }
+    };
+
+    for (int i = 0; i < 200'000; ++i) {
+        EngineEvent ev;
+        // Mostly a tight cluster, sometimes anywhere in the dense band
+        if (rng() % 8)
+            random_order(ev, 1'050'000, 2'000);
+        else
+            random_order(ev, 1'000'000, MAX_TICKS);
+
+        dense_engine.apply(ev);
+        sparse_engine.apply(ev);
+    }
+
+    InvariantChecker::check_book(*dense);
+    InvariantChecker::check_locks(*dense);
+    InvariantChecker::check_book(*sparse);
+    InvariantChecker::check_locks(*sparse);
+
+    if (!dense->orders.logical_equals(sparse->orders) ||
+        !dense->accounts.logical_equals(sparse->accounts) ||
+        dense->book.best_bid != sparse->book.best_bid ||
+        dense->book.best_ask != sparse->book.best_ask) {
+        std::fprintf(stderr, "Mismatch: sparse vs dense book\n");
+        std::abort();
+    }
+
+    // Prices across the whole trie band, until its node pool runs out
+    uint32_t peak_nodes = 0;
+    for (int i = 0; i < 300'000; ++i) {
+        EngineEvent ev;
+        random_order(ev, 1'000'000, TRIE_KEYS);
+        sparse_engine.apply(ev);
+
+        peak_nodes = std::max(peak_nodes, sparse->book.trie.node_live);
+        if (i % 50'000 == 0) {
+            InvariantChecker::check_book(*sparse);
+            InvariantChecker::check_locks(*sparse);
+        }
+    }
+
+    if (peak_nodes + TRIE_DEPTH < TRIE_NODES) {
+        std::fprintf(stderr, "Trie node pool never filled\n");
+        std::abort();
+    }
+
+    InvariantChecker::check_book(*sparse);
+    InvariantChecker::check_locks(*sparse);
+
+    refund_resting_buys(*sparse);
+    InvariantChecker::check_balances(
+        *sparse,
+        INITIAL_BALANCE * TEST_ACCOUNTS,
+        INITIAL_BALANCE * TEST_ACCOUNTS
+    );
+
+    std::free(dense);
+    std::free(sparse);
+}
+
+// ------------------------------------------------------------
+// L2 feed: a book rebuilt from level updates alone matches top_levels
+// after every event mix, on both level backends
+// ------------------------------------------------------------
+using DepthMirror = std::map<int64_t, DepthLevel>;
+
+static void check_depth(const OrderBook& book, const DepthMirror* mirror,
+                        std::vector<DepthLevel>& buf) {
+    for (uint8_t side = BUY; side <= SELL; ++side) {
+        const DepthMirror& m = mirror[side];
+        size_t n = book.top_levels(side, buf.data(), buf.size());
+
+        // Best first: highest bid, lowest ask
+        bool ok = n == m.size();
+        size_t i = 0;
+        auto same = [&](const DepthLevel& want) {
+            const DepthLevel& got = buf[i++];
+            return got.price == want.price && got.quantity == want.quantity &&
+                   got.orders == want.orders;
+        };
+        if (side == BUY) {
+            for (auto it = m.rbegin(); ok && it != m.rend(); ++it)
+                ok = same(it->second);
+        } else {
+            for (auto it = m.begin(); ok && it != m.end(); ++it)
+                ok = same(it->second);
+        }
+
+        // A short snapshot is the prefix of a full one
+        DepthLevel top[5];
+        size_t k = book.top_levels(side, top, 5);
+        ok = ok && k == std::min<size_t>(5, n);
+        for (size_t j = 0; ok && j < k; ++j)
+            ok = top[j].price == buf[j].price &&
+                 top[j].quantity == buf[j].quantity;
+
+        if (!ok) {
+            std::fprintf(stderr, "L2 feed diverged from the book (side %u)\n",
+                         side);
+            std::abort();
+        }
+    }
+}
+
+static void fuzz_depth_feed() {
+    constexpr InstrumentSpec SPECS[] = {
+        {0, TICK_SIZE, 1'000'000, 1'000'000 + MAX_TICKS * TICK_SIZE, false,
+         LevelBackend::DENSE},
+        {0, TICK_SIZE, 1'000'000, 1'000'000 + TRIE_KEYS * int64_t{TICK_SIZE},
+         false, LevelBackend::SPARSE}};
+
+    for (const InstrumentSpec& spec : SPECS) {
+        auto* state = static_cast<EngineState*>(
+            std::calloc(1, sizeof(EngineState)));
+        init_instrument(*state, spec);
+        auto* feed = new DepthRing(Backpressure::DROP);
+        MatchingEngine engine(*state, nullptr, nullptr, feed);
+        seed_accounts(*state);
+
+        DepthMirror mirror[2];
+        std::vector<DepthLevel> buf(MAX_TICKS);
+        std::vector<LevelUpdate> updates(DEPTH_RING_SIZE);
+
+        std::mt19937_64 rng(97531);
+        uint64_t seq = 0;
+        uint64_t grc = 0;
+
+        for (int i = 0; i < 100'000; ++i) {
+            EngineEvent ev{};
+            ev.header.sequence = ++seq;
+            uint64_t pick = rng() % 100;
+            uint64_t account = rng() % TEST_ACCOUNTS;
+
+            if (pick < 65 || state->orders.slot_top <= 1) {
+                // Bid and ask ranges overlap by a fifth, so the book
+                // keeps depth on both sides while limits still cross
+                uint8_t side = static_cast<uint8_t>(rng() % 2);
+                ev.header.type = EventType::NEW_ORDER;
+                ev.new_order.account_id = account;
+                ev.new_order.side       = side;
+                ev.new_order.price      = 1'000'000 + (side == SELL ? 400 : 0) +
+                                          static_cast<int64_t>(rng() % 500);
+                ev.new_order.quantity   = static_cast<int64_t>(rng() % 10) + 1;
+            } else if (pick < 90) {
+                ev.header.type = EventType::CANCEL;
+                ev.cancel.order_id = random_order_id(state->orders, rng);
+            } else if (pick < 99) {
+                ev = market_event(seq, account,
+                                  static_cast<uint8_t>(rng() % 2),
+                                  static_cast<int64_t>(rng() % 60), 0);
+            } else {
+                ev.header.type = EventType::RISK_CONTROL;
+                ev.risk.grc_sequence = ++grc;
+                ev.risk.command = RiskCommand::PURGE_ORDERS;
+                ev.risk.account_id = account;
+            }
+
+            engine.apply(ev);
+
+            size_t n = feed->ring.pop_batch(updates.data(), updates.size());
+            for (size_t j = 0; j < n; ++j) {
+                const LevelUpdate& u = updates[j];
+                if (u.sequence != seq) {
+                    std::fprintf(stderr, "Level update out of sequence\n");
+                    std::abort();
+                }
+                if (u.quantity == 0)
+                    mirror[u.side].erase(u.price);
+                else
+                    mirror[u.side][u.price] = {u.price, u.quantity, u.orders};
+            }
+
+            if (i % 100 == 0)
+                check_depth(state->book, mirror, buf);
+        }
+
+        if (feed->dropped != 0) {
+            std::fprintf(stderr, "L2 feed dropped updates\n");
+            std::abort();
+        }
+
+        check_depth(state->book, mirror, buf);
+        InvariantChecker::check_book(*state);
+        InvariantChecker::check_locks(*state);
+
+        delete feed;
+        std::free(state);
+    }
+}
+
 int main() {
     // ----------------------------
     // PRIMARY ENGINE
     // ----------------------------
     auto* state = new EngineState{};
     zero_state(*state);
-    MatchingEngine engine(*state);
+    StateDigest digest;
+    MatchingEngine engine(*state, nullptr, nullptr, nullptr, &digest);
 
-    for (uint64_t i = 0; i < TEST_ACCOUNTS; ++i) {
-        state->accounts[i].base.available  = INITIAL_BALANCE;
-        state->accounts[i].quote.available = INITIAL_BALANCE;
-    }
+    seed_accounts(*state);
+    digest.rebuild(*state);
+
+    // Primary digest every DIGEST_EVERY events, for the replay to match
+    std::vector<uint64_t> checkpoints;
 
     std::mt19937_64 rng(12345);
-    std::vector<EngineEvent> log;
-    log.reserve(500'000);
 
-    for (uint64_t i = 1; i <= 500'000; ++i) {
+    // Every applied event goes through the on-disk journal
+    journal_remove_segments(JOURNAL_DIR);
+
+    JournalConfig jcfg;
+    jcfg.dir = JOURNAL_DIR;
+    jcfg.segment_records = 1u << 17;   // forces segment rotation
+    auto* log = new JournalWriter(jcfg);
+
+    for (uint64_t i = 1; i <= FUZZ_EVENTS; ++i) {
         EngineEvent ev{};
         ev.header.sequence = i;
-        ev.header.type = EventType::NEW_ORDER;
 
-        ev.new_order.account_id = rng() % TEST_ACCOUNTS;
-        ev.new_order.side       = rng() % 2;
-        ev.new_order.price      = 1'000'000 + (rng() % 1000);
-        ev.new_order.quantity   = (rng() % 10) + 1;
+        if (i % 997 == 0) {
+            ev.header.type = EventType::RISK_CONTROL;
+            ev.risk.grc_sequence = i;
+            ev.risk.command = RiskCommand::PURGE_ORDERS;
+            ev.risk.account_id = rng() % TEST_ACCOUNTS;
+        } else if (state->orders.slot_top > 1 && rng() % 4 == 0) {
+            ev.header.type = EventType::CANCEL;
+            ev.cancel.order_id = random_order_id(state->orders, rng);
+        } else {
+            ev.header.type = EventType::NEW_ORDER;
 
-        log.push_back(ev);
+            ev.new_order.account_id = rng() % TEST_ACCOUNTS;
+            ev.new_order.side       = rng() % 2;
+            ev.new_order.price      = 1'000'000 + (rng() % 1000);
+            ev.new_order.quantity   = (rng() % 10) + 1;
+        }
+
+        // A cancel carrying an outdated id must leave the slot's current
+        // order alone
+        uint32_t target = 0;
+        bool stale = false;
+        if (ev.header.type == EventType::CANCEL) {
+            target = static_cast<uint32_t>(ev.cancel.order_id &
+                                           ORDER_SLOT_MASK);
+            stale = state->orders.cold[target].id != ev.cancel.order_id &&
+                    state->orders.hot[target].state == OrderState::LIVE;
+        }
+
+        log->append(ev);
         engine.apply(ev);
+
+        if (stale && state->orders.hot[target].state != OrderState::LIVE) {
+            std::fprintf(stderr, "Stale cancel %llu hit slot %u\n",
+                         (unsigned long long)ev.cancel.order_id, target);
+            std::abort();
+        }
+
+        // A purge walks only the account's own list; it must still
+        // leave none of its orders resting
+        if (ev.header.type == EventType::RISK_CONTROL) {
+            uint32_t slot = state->accounts.find(ev.risk.account_id);
+            for (uint32_t oid = 1; oid < state->orders.slot_top; ++oid) {
+                if (state->orders.hot[oid].account == slot &&
+                    state->orders.hot[oid].state == OrderState::LIVE) {
+                    std::fprintf(stderr, "Purge left order %llu resting\n",
+                                 static_cast<unsigned long long>(
+                                     state->orders.cold[oid].id));
+                    std::abort();
+                }
+            }
+        }
+
+        if (i % DIGEST_EVERY == 0) {
+            checkpoints.push_back(digest.value(*state));
+            if (i % (DIGEST_EVERY * 16) == 0) {
+                check_digest(digest, *state);
+                InvariantChecker::check_locks(*state);
+            }
+        }
     }
 
+    delete log;   // final commit
+
     // ----------------------------
     // REPLAY ENGINE
     // ----------------------------
     auto* replay = new EngineState{};
     zero_state(*replay);
-    MatchingEngine replay_engine(*replay);
+    StateDigest replay_digest;
+    MatchingEngine replay_engine(*replay, nullptr, nullptr, nullptr,
+                                 &replay_digest);
 
-    for (uint64_t i = 0; i < TEST_ACCOUNTS; ++i) {
-        replay->accounts[i].base.available  = INITIAL_BALANCE;
-        replay->accounts[i].quote.available = INITIAL_BALANCE;
+    seed_accounts(*replay);
+    replay_digest.rebuild(*replay);
+
+    // Batched path: journal batches go through apply_batch. Batches end
+    // on every checkpoint, so the replay compares one value at each.
+    JournalReader reader(JOURNAL_DIR);
+    const EngineEvent* batch[64];
+    EngineEvent burst[64];
+    size_t compared = 0;
+    while (size_t n = reader.next_batch(batch, 64)) {
+        for (size_t i = 0; i < n; ++i)
+            burst[i] = *batch[i];
+        replay_engine.apply_batch(burst, n);
+
+        uint64_t seq = replay->last_sequence;
+        if (seq % DIGEST_EVERY != 0) continue;
+        if (replay_digest.value(*replay) !=
+            checkpoints[seq / DIGEST_EVERY - 1]) {
+            std::fprintf(stderr, "Replay digest differs at %llu\n",
+                         (unsigned long long)seq);
+            std::abort();
+        }
+        ++compared;
     }
 
-    for (const auto& ev : log)
-        replay_engine.apply(ev);
+    if (compared != checkpoints.size()) {
+        std::fprintf(stderr, "Replay compared %zu of %zu digests\n",
+                     compared, checkpoints.size());
+        std::abort();
+    }
+
+    if (reader.records_read() != FUZZ_EVENTS) {
+        std::fprintf(stderr, "Journal: read %llu of %llu events\n",
+            (unsigned long long)reader.records_read(),
+            (unsigned long long)FUZZ_EVENTS);
+        std::abort();
+    }
 
     // ----------------------------
     // DETERMINISM CHECK
     // ----------------------------
     assert_deterministic_equal(*state, *replay);
+    if (digest.value(*state) != replay_digest.value(*replay)) {
+        std::fprintf(stderr, "Digests differ on equal states\n");
+        std::abort();
+    }
 
-    // ------------------------------------------------
-    // FINAL REFUND OF ALL RESTING BUY ORDERS
-    // (fuzz has NO cancel events → mandatory)
-    // ------------------------------------------------
-    for (uint64_t oid = 1; oid < state->orders.next_order_id; ++oid) {
-        if (state->orders.state[oid] != OrderState::LIVE)
-            continue;
-
-        if (state->orders.side[oid] != OrderSide::BUY)
-            continue;
+    // One differing order at the same sequence shows up in the digest,
+    // and the full walk then names the tables
+    {
+        EngineEvent a{};
+        a.header.sequence = FUZZ_EVENTS + 1;
+        a.header.type = EventType::NEW_ORDER;
+        a.new_order.account_id = 1;
+        a.new_order.side       = BUY;
+        a.new_order.price      = 1'000'000;
+        a.new_order.quantity   = 1;
+        EngineEvent b = a;
+        b.new_order.quantity   = 2;
 
-        int64_t rem = state->orders.qty_remaining[oid];
-        if (rem <= 0)
-            continue;
+        engine.apply(a);
+        replay_engine.apply(b);
+        if (digest.value(*state) == replay_digest.value(*replay) ||
+            state_difference(*state, *replay) == nullptr) {
+            std::fprintf(stderr, "Diverged states share a digest\n");
+            std::abort();
+        }
+        check_digest(digest, *state);
+        check_digest(replay_digest, *replay);
+    }
 
-        uint64_t acct_id = state->orders.account_id[oid];
-        Account& acct = state->accounts[acct_id];
+    // The same level filed under another price index is a different book
+    {
+        auto* moved = new EngineState;
+        std::memcpy(moved, state, sizeof(EngineState));
+        OrderBook& b = moved->book;
 
-        __int128 notional =
-            (__int128)state->orders.price[oid] * rem;
-        __int128 fee = fee_ceiling_local(notional);
+        int32_t from = b.best_bid;
+        int32_t to = 0;
+        while (b.buy_levels[to] != 0) ++to;
 
-        acct.quote.locked    -= (notional + fee);
-        acct.quote.available += (notional + fee);
+        b.buy_levels[to] = b.buy_levels[from];
+        b.buy_levels[from] = 0;
+        b.buy_bits.set(to);
+        b.buy_bits.clear(from);
 
-        state->orders.state[oid] = OrderState::CANCELLED;
+        StateDigest a, m;
+        a.rebuild(*state);
+        m.rebuild(*moved);
+        if (a.value(*state) == m.value(*moved) ||
+            state_difference(*state, *moved) == nullptr) {
+            std::fprintf(stderr, "Moved level keeps its digest\n");
+            std::abort();
+        }
+        delete moved;
     }
 
+    // ----------------------------
+    // BOOK STRUCTURE
+    // ----------------------------
+    InvariantChecker::check_book(*state);
+    InvariantChecker::check_locks(*state);
+
+    // ------------------------------------------------
+    // FINAL REFUND OF ALL RESTING BUY ORDERS
+    // (random cancels leave most of them resting)
+    // ------------------------------------------------
+    refund_resting_buys(*state);
+
     // ----------------------------
     // BALANCE INVARIANTS
     // ----------------------------
@@ -145,5 +1001,14 @@ int main() {
 
     delete state;
     delete replay;
+
+    fuzz_drifting_band();
+    fuzz_sparse_levels();
+    fuzz_fee_reciprocal();
+    fuzz_fee_rounding_locks();
+    fuzz_balance_limit();
+    fuzz_account_capacity();
+    fuzz_market_orders();
+    fuzz_depth_feed();
     return 0;
 }
\ No newline at end of file
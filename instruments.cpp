@@ -0,0 +1,30 @@
+#include "instruments.h"
+
+bool instrument_spec_valid(const InstrumentSpec& s) {
+    if (s.id >= MAX_INSTRUMENTS) return false;
+
+    if (s.tick_size <= 0) return false;
+    if (s.min_price <= 0 || s.max_price <= s.min_price) return false;
+
+    // Whole ticks only, within the index capacity
+    int64_t span = s.max_price - s.min_price;
+    return span % s.tick_size == 0 &&
+           span / s.tick_size <= band_capacity(s.levels);
+}
+
+bool InstrumentRegistry::add(const InstrumentSpec& spec) {
+    if (!instrument_spec_valid(spec) || present[spec.id])
+        return false;
+
+    specs[spec.id]   = spec;
+    present[spec.id] = true;
+    ids[count++]     = spec.id;
+    return true;
+}
+
+void init_instrument(EngineState& state, const InstrumentSpec& spec) {
+    state.instrument = spec.id;
+    state.orders.init();
+    state.book.init(spec.min_price, spec.max_price, spec.tick_size,
+                    spec.recenter, spec.levels);
+}
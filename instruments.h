@@ -0,0 +1,47 @@
+#pragma once
+#include "engine_state.h"
+#include <cstdint>
+
+// =======================
+// Instruments
+// =======================
+//
+// One EngineState (book, order table and account ledger) per instrument.
+// Each state has exactly one writer, so balances stay consistent without
+// cross-instrument locking; an account's funds are allocated per
+// instrument ledger.
+
+constexpr uint32_t MAX_INSTRUMENTS = 1024;
+
+struct InstrumentSpec {
+    uint32_t id;
+    int64_t  tick_size;
+    int64_t  min_price;
+    int64_t  max_price;     // exclusive; at most band_capacity() ticks above min
+    bool     recenter;      // follow the market instead of a fixed band
+    LevelBackend levels;    // SPARSE for bands wider than MAX_TICKS
+};
+
+// The band a bare MatchingEngine gives a zeroed state
+constexpr InstrumentSpec DEFAULT_INSTRUMENT{
+    0, TICK_SIZE, 1'000'000, 1'000'000 + MAX_TICKS * TICK_SIZE, false,
+    LevelBackend::DENSE};
+
+struct InstrumentRegistry {
+    InstrumentSpec specs[MAX_INSTRUMENTS];
+    bool           present[MAX_INSTRUMENTS];
+    uint32_t       ids[MAX_INSTRUMENTS];      // registration order
+    uint32_t       count;
+
+    // False on a duplicate id or an invalid spec
+    bool add(const InstrumentSpec& spec);
+
+    const InstrumentSpec* find(uint32_t id) const {
+        return (id < MAX_INSTRUMENTS && present[id]) ? &specs[id] : nullptr;
+    }
+};
+
+bool instrument_spec_valid(const InstrumentSpec& spec);
+
+// Initialise a zeroed state as the book for `spec`
+void init_instrument(EngineState& state, const InstrumentSpec& spec);
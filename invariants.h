@@ -10,11 +10,13 @@ struct InvariantChecker {
         __int128 base_total = 0;
         __int128 quote_total = 0;
 
-        for (uint64_t i = 0; i < MAX_ACCOUNTS; ++i) {
-            base_total  += state.accounts[i].base.available;
-            base_total  += state.accounts[i].base.locked;
-            quote_total += state.accounts[i].quote.available;
-            quote_total += state.accounts[i].quote.locked;
+        const Accounts& accts = state.accounts;
+
+        for (uint32_t i = 0; i < accts.live_end(); ++i) {
+            base_total  += accts.hot[i].base_available;
+            base_total  += accts.cold[i].base_locked;
+            quote_total += accts.hot[i].quote_available;
+            quote_total += accts.cold[i].quote_locked;
         }
 
         if (base_total != base_supply)
@@ -24,4 +26,237 @@ struct InvariantChecker {
             ENGINE_ABORT("quote invariant");
 #endif
     }
-};
\ No newline at end of file
+
+    // No lock is negative, and each account's locks are exactly what its
+    // resting orders hold: base_locked the SELLs' remaining quantity,
+    // quote_locked the BUYs' reservations, each of which still covers
+    // its order's remaining notional.
+    static void check_locks(const EngineState& state) {
+#ifndef ENGINE_PERF_MODE
+        const Orders& orders = state.orders;
+        const Accounts& accts = state.accounts;
+
+        for (uint32_t slot = 0; slot < accts.live_end(); ++slot) {
+            const AccountCold& cold = accts.cold[slot];
+            if (cold.base_locked < 0 || cold.quote_locked < 0)
+                ENGINE_ABORT("negative lock");
+
+            __int128 base = 0;
+            __int128 quote = 0;
+            for (uint32_t oid = cold.order_head; oid;
+                 oid = orders.hot[oid].acct_next) {
+                const OrderHot& h = orders.hot[oid];
+                const OrderCold& c = orders.cold[oid];
+                if (h.side == OrderSide::SELL) {
+                    base += h.qty_remaining;
+                    continue;
+                }
+                if (c.quote_reserved <
+                    static_cast<__int128>(c.price) * h.qty_remaining)
+                    ENGINE_ABORT("reservation short of notional");
+                quote += c.quote_reserved;
+            }
+
+            if (base != cold.base_locked || quote != cold.quote_locked)
+                ENGINE_ABORT("locks differ from resting orders");
+        }
+#endif
+    }
+
+    // Every linked order is LIVE and sits at its own price, level counts
+    // and quantities match their lists, every LIVE order is linked, and
+    // best_bid/best_ask (and their cached handles) point at the outermost
+    // occupied levels.
+    // Every LIVE order is also on its account's list, oldest first.
+    // The level index agrees with itself: bitmaps with the handle arrays,
+    // or trie masks with children. Every pool slot below the top is
+    // either in use or free-listed.
+    static void check_book(const EngineState& state) {
+#ifndef ENGINE_PERF_MODE
+        const Orders& orders = state.orders;
+        const OrderBook& book = state.book;
+
+        if (book.tick_size <= 0 || book.ticks <= 0 ||
+            book.ticks > band_capacity(book.backend) ||
+            book.max_price != book.min_price + book.ticks * book.tick_size)
+            ENGINE_ABORT("inconsistent price band");
+
+        if (book.backend == LevelBackend::DENSE)
+            check_dense_index(book);
+        else
+            check_trie(book.trie);
+
+        uint64_t linked = 0;
+        uint32_t live_levels = 0;
+        int32_t best_bid = -1;
+        int32_t best_ask = -1;
+
+        for (uint8_t side = BUY; side <= SELL; ++side) {
+            for (int32_t i = book.next_level(side, 0); i != -1;
+                 i = book.next_level(side, i + 1)) {
+                const PriceLevel* lvl = book.level(side, i);
+
+                if (!lvl)
+                    ENGINE_ABORT("level index out of sync");
+                if (i >= book.ticks)
+                    ENGINE_ABORT("level outside band");
+                if (lvl->count == 0 || lvl->head == 0)
+                    ENGINE_ABORT("empty level left in book");
+
+                uint32_t n = 0;
+                uint32_t prev = 0;
+                int64_t qty = 0;
+                for (uint32_t oid = lvl->head; oid;
+                     oid = orders.hot[oid].next) {
+                    const OrderHot& h = orders.hot[oid];
+                    qty += h.qty_remaining;
+                    if (h.state != OrderState::LIVE)
+                        ENGINE_ABORT("dead order linked");
+                    if (static_cast<uint8_t>(h.side) != side ||
+                        book.index_to_price(i) != orders.cold[oid].price)
+                        ENGINE_ABORT("order on wrong level");
+                    if (h.prev != prev)
+                        ENGINE_ABORT("broken prev link");
+                    prev = oid;
+                    ++n;
+                }
+
+                if (n != lvl->count || prev != lvl->tail)
+                    ENGINE_ABORT("level count / tail mismatch");
+                if (qty != lvl->quantity)
+                    ENGINE_ABORT("level quantity mismatch");
+
+                linked += n;
+                ++live_levels;
+                if (side == BUY) best_bid = i;
+                else if (best_ask == -1) best_ask = i;
+            }
+        }
+
+        uint32_t free_levels = 0;
+        for (uint32_t h = book.level_free_head; h;
+             h = book.level_pool[h].next_free) {
+            if (++free_levels >= LEVEL_POOL_SIZE)
+                ENGINE_ABORT("level free list cycle");
+        }
+
+        if (live_levels + free_levels != book.level_pool_top - 1)
+            ENGINE_ABORT("level pool leak");
+
+        uint64_t live = 0;
+        for (uint32_t oid = 1; oid < orders.slot_top; ++oid)
+            if (orders.hot[oid].state == OrderState::LIVE) ++live;
+
+        if (live != linked)
+            ENGINE_ABORT("live order not linked");
+
+        // Every slot not holding a LIVE order is on the free list
+        uint64_t free_slots = 0;
+        for (uint32_t oid = orders.free_head; oid;
+             oid = orders.hot[oid].next) {
+            if (oid >= orders.slot_top ||
+                orders.hot[oid].state == OrderState::LIVE ||
+                (orders.cold[oid].id & ORDER_SLOT_MASK) != oid ||
+                ++free_slots >= MAX_ORDERS)
+                ENGINE_ABORT("order free list corrupt");
+        }
+
+        if (live + free_slots != orders.slot_top - 1)
+            ENGINE_ABORT("order slot leak");
+
+        if (check_account_lists(state) != live)
+            ENGINE_ABORT("live order missing from its account list");
+
+        if (book.best_bid != best_bid || book.best_ask != best_ask)
+            ENGINE_ABORT("stale best price");
+
+        if (book.best_bid_level !=
+                (best_bid == -1 ? 0 : book.handle(BUY, best_bid)) ||
+            book.best_ask_level !=
+                (best_ask == -1 ? 0 : book.handle(SELL, best_ask)))
+            ENGINE_ABORT("stale best level handle");
+#endif
+    }
+
+private:
+    // Each account's list holds only its own LIVE orders, with
+    // consistent back links; returns how many it holds in total
+    static uint64_t check_account_lists(const EngineState& state) {
+        const Orders& orders = state.orders;
+        const Accounts& accts = state.accounts;
+        uint64_t listed = 0;
+
+        for (uint32_t slot = 0; slot < accts.live_end(); ++slot) {
+            uint32_t prev = 0;
+            for (uint32_t oid = accts.cold[slot].order_head; oid;
+                 oid = orders.hot[oid].acct_next) {
+                if (oid >= orders.slot_top ||
+                    orders.hot[oid].state != OrderState::LIVE ||
+                    orders.hot[oid].account != slot ||
+                    orders.hot[oid].acct_prev != prev ||
+                    listed >= MAX_ORDERS)
+                    ENGINE_ABORT("account order list corrupt");
+                prev = oid;
+                ++listed;
+            }
+            if (accts.cold[slot].order_tail != prev)
+                ENGINE_ABORT("account order list tail");
+        }
+        return listed;
+    }
+
+    static void check_dense_index(const OrderBook& book) {
+        for (int32_t i = 0; i < MAX_TICKS; ++i) {
+            for (uint8_t side = BUY; side <= SELL; ++side) {
+                uint32_t h = (side == BUY) ? book.buy_levels[i]
+                                           : book.sell_levels[i];
+                bool bit = (side == BUY) ? book.buy_bits.test(i)
+                                         : book.sell_bits.test(i);
+
+                if (bit != (h != 0))
+                    ENGINE_ABORT("level bitmap out of sync");
+                if (h && i >= book.ticks)
+                    ENGINE_ABORT("level outside band");
+            }
+        }
+    }
+
+    // Reachable nodes, excluding the root; the mask matches the children
+    static uint32_t check_trie_node(const LevelTrie& t, uint32_t h,
+                                    uint32_t level) {
+        const TrieNode& n = t.nodes[h];
+        uint32_t reachable = 0;
+
+        for (uint32_t d = 0; d < 64; ++d) {
+            bool present = (n.mask >> d) & 1;
+            if (present != (n.child[d] != 0))
+                ENGINE_ABORT("trie mask out of sync");
+            if (!present || level + 1 == TRIE_DEPTH) continue;
+
+            if (n.child[d] >= t.node_top)
+                ENGINE_ABORT("trie handle out of range");
+            if (t.nodes[n.child[d]].mask == 0)
+                ENGINE_ABORT("empty trie node left linked");
+            reachable += 1 + check_trie_node(t, n.child[d], level + 1);
+        }
+        return reachable;
+    }
+
+    static void check_trie(const LevelTrie& t) {
+        uint32_t reachable = 2;
+        for (uint8_t side = BUY; side <= SELL; ++side)
+            reachable += check_trie_node(t, t.root[side], 0);
+
+        if (reachable != t.node_live)
+            ENGINE_ABORT("trie node count mismatch");
+
+        uint32_t free_nodes = 0;
+        for (uint32_t h = t.node_free_head; h; h = t.nodes[h].child[0]) {
+            if (++free_nodes >= TRIE_NODES)
+                ENGINE_ABORT("trie free list cycle");
+        }
+
+        if (t.node_live + free_nodes != t.node_top - 1)
+            ENGINE_ABORT("trie node leak");
+    }
+};
@@ -0,0 +1,491 @@
+#include "journal.h"
+#include "crc32c.h"
+#include "engine_common.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>      // snprintf, sscanf
+#include <cstring>     // memcpy, strncpy
+#include <dirent.h>    // opendir, readdir
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, msync, munmap
+#include <sys/stat.h>  // mkdir, fstat
+#include <unistd.h>    // ftruncate, fsync, close
+
+static void die(const char*) {
+    ENGINE_ABORT("reason");
+}
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void segment_path(char* out, size_t n, const char* dir, uint64_t index) {
+    std::snprintf(out, n, "%s/journal-%020llu.seg",
+                  dir, static_cast<unsigned long long>(index));
+}
+
+static size_t segment_bytes(uint64_t capacity) {
+    return JOURNAL_HEADER_BYTES +
+           static_cast<size_t>(capacity) * sizeof(JournalRecord);
+}
+
+static bool header_valid(const JournalSegmentHeader& h) {
+    return h.magic == JOURNAL_MAGIC &&
+           h.version == JOURNAL_VERSION &&
+           h.header_size == JOURNAL_HEADER_BYTES &&
+           h.record_size == sizeof(JournalRecord);
+}
+
+static bool record_ok(const JournalRecord& r) {
+    return r.length == sizeof(EngineEvent) &&
+           r.crc == crc32c(&r.event, sizeof(EngineEvent));
+}
+
+// A segment whose creation was cut short before its header was synced:
+// short, or pre-allocated zeros with no slot that could hold a record.
+// The newest segment may be left like this; it holds nothing.
+static bool segment_blank(const uint8_t* map, size_t size) {
+    for (size_t off = JOURNAL_HEADER_BYTES;
+         off + sizeof(JournalRecord) <= size; off += sizeof(JournalRecord))
+        if (reinterpret_cast<const JournalRecord*>(map + off)->length != 0)
+            return false;
+    return true;
+}
+
+// Maps `fd` whole; nullptr for an empty file, which mmap() refuses
+static uint8_t* map_segment(int fd, size_t& size, int prot) {
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) die("stat segment");
+
+    size = static_cast<size_t>(st.st_size);
+    if (size == 0) return nullptr;
+
+    void* m = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) die("mmap segment");
+    return static_cast<uint8_t*>(m);
+}
+
+static bool segment_valid(const uint8_t* map, size_t size) {
+    if (size < JOURNAL_HEADER_BYTES) return false;
+    const auto* hdr = reinterpret_cast<const JournalSegmentHeader*>(map);
+    return header_valid(*hdr) && segment_bytes(hdr->capacity) == size;
+}
+
+// Sequence of the last valid record of a complete segment
+static uint64_t segment_last_sequence(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) die("open segment");
+
+    size_t size = 0;
+    uint8_t* map = map_segment(fd, size, PROT_READ);
+    if (!segment_valid(map, size))
+        die("bad journal segment header");
+
+    const auto* hdr = reinterpret_cast<const JournalSegmentHeader*>(map);
+    const auto* records =
+        reinterpret_cast<const JournalRecord*>(map + JOURNAL_HEADER_BYTES);
+
+    uint64_t pos = 0;
+    while (pos < hdr->capacity && record_ok(records[pos]))
+        ++pos;
+    uint64_t last = pos ? records[pos - 1].event.header.sequence
+                        : hdr->first_sequence - 1;
+
+    ::munmap(map, size);
+    ::close(fd);
+    return last;
+}
+
+bool journal_segment_range(const char* dir, uint64_t& first, uint64_t& last) {
+    DIR* d = ::opendir(dir);
+    if (!d) return false;
+
+    bool found = false;
+    while (dirent* e = ::readdir(d)) {
+        unsigned long long idx;
+        char tail;
+        if (std::sscanf(e->d_name, "journal-%20llu.se%c", &idx, &tail) != 2 ||
+            tail != 'g')
+            continue;
+
+        if (!found || idx < first) first = idx;
+        if (!found || idx > last)  last = idx;
+        found = true;
+    }
+
+    ::closedir(d);
+    return found;
+}
+
+void journal_remove_segments(const char* dir) {
+    uint64_t first, last;
+    if (!journal_segment_range(dir, first, last)) return;
+
+    char path[320];
+    for (uint64_t i = first; i <= last; ++i) {
+        segment_path(path, sizeof(path), dir, i);
+        ::unlink(path);
+    }
+}
+
+// =======================
+// Writer
+// =======================
+
+JournalWriter::JournalWriter(const JournalConfig& cfg) : cfg_(cfg) {
+    if (::mkdir(cfg_.dir, 0755) != 0 && errno != EEXIST)
+        die("mkdir journal");
+
+    last_commit_ns_ = now_ns();
+
+    uint64_t first, last;
+    if (!journal_segment_range(cfg_.dir, first, last))
+        return;   // first append creates segment 0
+
+    // Resume the newest segment after its last valid record
+    char path[320];
+    segment_path(path, sizeof(path), cfg_.dir, last);
+
+    fd_ = ::open(path, O_RDWR);
+    if (fd_ < 0) die("open segment");
+
+    map_ = map_segment(fd_, map_size_, PROT_READ | PROT_WRITE);
+
+    if (!segment_valid(map_, map_size_)) {
+        if (!segment_blank(map_, map_size_))
+            die("bad journal segment header");
+
+        // Created but never synced: start it again after the previous
+        // segment's last record, or on the first append if it is the
+        // only one
+        close_segment();
+        segment_index_ = last;
+        if (last > first) {
+            segment_path(path, sizeof(path), cfg_.dir, last - 1);
+            last_sequence_ = segment_last_sequence(path);
+            synced_sequence_ = last_sequence_;
+            open_segment(last, last_sequence_ + 1);
+        }
+        return;
+    }
+
+    const auto* hdr = reinterpret_cast<const JournalSegmentHeader*>(map_);
+
+    records_ = reinterpret_cast<JournalRecord*>(map_ + JOURNAL_HEADER_BYTES);
+    segment_index_ = last;
+    cfg_.segment_records = hdr->capacity;
+
+    write_pos_ = 0;
+    while (write_pos_ < hdr->capacity && record_ok(records_[write_pos_]))
+        ++write_pos_;
+
+    // Anything past the last good record is a torn tail. Pages reach
+    // the disk in any order, so records after the torn one may still
+    // carry a valid CRC; if only the first new append survived a second
+    // crash, a reader would run on into them. Clear every record past
+    // write_pos_ that could ever read as valid (length != 0), and make
+    // that durable before appending again.
+    uint64_t clear_end = write_pos_;
+    for (uint64_t pos = write_pos_; pos < hdr->capacity; ++pos) {
+        if (records_[pos].length == 0) continue;
+        std::memset(&records_[pos], 0, sizeof(JournalRecord));
+        clear_end = pos + 1;
+    }
+
+    if (clear_end > write_pos_) {
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t from = JOURNAL_HEADER_BYTES +
+                      static_cast<size_t>(write_pos_) * sizeof(JournalRecord);
+        size_t to   = JOURNAL_HEADER_BYTES +
+                      static_cast<size_t>(clear_end) * sizeof(JournalRecord);
+        from &= ~(page - 1);
+
+        if (::msync(map_ + from, to - from, MS_SYNC) != 0)
+            die("msync torn tail");
+    }
+
+    synced_pos_ = write_pos_;
+    last_sequence_ = write_pos_
+        ? records_[write_pos_ - 1].event.header.sequence
+        : hdr->first_sequence - 1;
+    synced_sequence_ = last_sequence_;
+}
+
+JournalWriter::~JournalWriter() {
+    commit();
+    close_segment();
+}
+
+void JournalWriter::open_segment(uint64_t index, uint64_t first_sequence) {
+    char path[320];
+    segment_path(path, sizeof(path), cfg_.dir, index);
+
+    fd_ = ::open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd_ < 0) die("create segment");
+
+    map_size_ = segment_bytes(cfg_.segment_records);
+
+    // Reserve the blocks up front so appends never extend the file
+#if defined(__linux__)
+    if (::posix_fallocate(fd_, 0, static_cast<off_t>(map_size_)) != 0)
+        die("fallocate segment");
+#else
+    if (::ftruncate(fd_, static_cast<off_t>(map_size_)) != 0)
+        die("ftruncate segment");
+#endif
+
+    map_ = static_cast<uint8_t*>(
+        ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+    if (map_ == MAP_FAILED) die("mmap segment");
+
+    auto* hdr = reinterpret_cast<JournalSegmentHeader*>(map_);
+    hdr->magic          = JOURNAL_MAGIC;
+    hdr->version        = JOURNAL_VERSION;
+    hdr->header_size    = JOURNAL_HEADER_BYTES;
+    hdr->record_size    = sizeof(JournalRecord);
+    hdr->segment_index  = index;
+    hdr->first_sequence = first_sequence;
+    hdr->capacity       = cfg_.segment_records;
+
+    if (::msync(map_, JOURNAL_HEADER_BYTES, MS_SYNC) != 0)
+        die("msync header");
+
+    // Make the new directory entry durable too
+    int dfd = ::open(cfg_.dir, O_RDONLY);
+    if (dfd >= 0) {
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+
+    records_ = reinterpret_cast<JournalRecord*>(map_ + JOURNAL_HEADER_BYTES);
+    segment_index_ = index;
+    write_pos_ = 0;
+    synced_pos_ = 0;
+}
+
+void JournalWriter::close_segment() {
+    if (map_) ::munmap(map_, map_size_);
+    if (fd_ >= 0) ::close(fd_);
+
+    map_ = nullptr;
+    records_ = nullptr;
+    fd_ = -1;
+}
+
+void JournalWriter::append(const EngineEvent& ev) {
+    if (!records_) {
+        open_segment(segment_index_, ev.header.sequence);
+    } else if (write_pos_ == cfg_.segment_records) {
+        commit();
+        close_segment();
+        open_segment(segment_index_ + 1, ev.header.sequence);
+    }
+
+    JournalRecord& r = records_[write_pos_];
+    std::memcpy(&r.event, &ev, sizeof(EngineEvent));
+    r.crc    = crc32c(&r.event, sizeof(EngineEvent));
+    r.length = sizeof(EngineEvent);
+
+    ++write_pos_;
+    last_sequence_ = ev.header.sequence;
+
+    uint64_t pending = write_pos_ - synced_pos_;
+
+    if (cfg_.commit_every && pending >= cfg_.commit_every) {
+        commit();
+    } else if (cfg_.commit_interval_ns && (write_pos_ & 63) == 0 &&
+               now_ns() - last_commit_ns_ >= cfg_.commit_interval_ns) {
+        // Clock is sampled every 64 appends to keep it off the hot path
+        commit();
+    }
+}
+
+// One msync over the dirty record range covers every event appended
+// since the last commit (group commit).
+void JournalWriter::commit() {
+    if (!records_ || write_pos_ == synced_pos_) return;
+
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+    size_t from = JOURNAL_HEADER_BYTES +
+                  static_cast<size_t>(synced_pos_) * sizeof(JournalRecord);
+    size_t to   = JOURNAL_HEADER_BYTES +
+                  static_cast<size_t>(write_pos_) * sizeof(JournalRecord);
+
+    from &= ~(page - 1);
+
+    if (::msync(map_ + from, to - from, MS_SYNC) != 0)
+        die("msync records");
+
+    synced_pos_ = write_pos_;
+    synced_sequence_ = last_sequence_;
+    last_commit_ns_ = now_ns();
+    ++commits_;
+}
+
+// =======================
+// Reader
+// =======================
+
+JournalReader::JournalReader(const char* dir) {
+    std::strncpy(dir_, dir, sizeof(dir_) - 1);
+    dir_[sizeof(dir_) - 1] = '\0';
+
+    // A blank first segment is retried by next() like an empty directory
+    have_segments_ =
+        journal_segment_range(dir_, first_index_, last_index_) &&
+        open_segment(first_index_);
+}
+
+JournalReader::~JournalReader() {
+    close_segment();
+}
+
+// A blank segment (see segment_blank) is the end of the log for now:
+// false, with the current segment left in place, so next() tries again
+// once the writer has started it over
+bool JournalReader::open_segment(uint64_t index) {
+    char path[320];
+    segment_path(path, sizeof(path), dir_, index);
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    size_t size = 0;
+    uint8_t* map = map_segment(fd, size, PROT_READ);
+
+    if (!segment_valid(map, size)) {
+        if (!segment_blank(map, size))
+            die("bad journal segment header");
+        if (map) ::munmap(map, size);
+        ::close(fd);
+        return false;
+    }
+
+    close_segment();
+    fd_ = fd;
+    map_ = map;
+    map_size_ = size;
+
+    const auto* hdr = reinterpret_cast<const JournalSegmentHeader*>(map_);
+
+    // Replay reads front to back exactly once: ask for aggressive
+    // readahead (and huge pages where the filesystem supports them).
+    ::madvise(map_, map_size_, MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+    ::madvise(map_, map_size_, MADV_HUGEPAGE);
+#endif
+
+    // Start pulling the following segment in while this one is replayed
+#if defined(__linux__)
+    char next_path[320];
+    segment_path(next_path, sizeof(next_path), dir_, index + 1);
+    int next_fd = ::open(next_path, O_RDONLY);
+    if (next_fd >= 0) {
+        ::posix_fadvise(next_fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(next_fd);
+    }
+#endif
+
+    records_ = reinterpret_cast<JournalRecord*>(map_ + JOURNAL_HEADER_BYTES);
+    capacity_ = hdr->capacity;
+    first_sequence_ = hdr->first_sequence;
+    segment_index_ = index;
+    read_pos_ = 0;
+    return true;
+}
+
+void JournalReader::close_segment() {
+    if (map_) ::munmap(map_, map_size_);
+    if (fd_ >= 0) ::close(fd_);
+
+    map_ = nullptr;
+    records_ = nullptr;
+    fd_ = -1;
+}
+
+bool JournalReader::record_valid(uint64_t pos) const {
+    return record_ok(records_[pos]);
+}
+
+void JournalReader::seek(uint64_t after_sequence) {
+    if (!have_segments_) return;
+
+    // Newest segment that starts at or before the target
+    uint64_t idx = last_index_;
+    for (;; --idx) {
+        if (open_segment(idx) && first_sequence_ <= after_sequence + 1)
+            break;
+        if (idx == first_index_) {
+            open_segment(first_index_);
+            return;   // journal starts after the target
+        }
+    }
+
+    // Sequences are contiguous within a segment
+    uint64_t pos = after_sequence + 1 - first_sequence_;
+    if (pos > capacity_) pos = capacity_;
+
+    if (pos > 0 && pos <= capacity_ &&
+        record_valid(pos - 1) &&
+        records_[pos - 1].event.header.sequence == after_sequence) {
+        read_pos_ = pos;
+        return;
+    }
+
+    // Fall back to a scan
+    read_pos_ = 0;
+    while (read_pos_ < capacity_ && record_valid(read_pos_) &&
+           records_[read_pos_].event.header.sequence <= after_sequence)
+        ++read_pos_;
+}
+
+size_t JournalReader::next_batch(const EngineEvent** out, size_t max) {
+    if (max == 0) return 0;
+
+    // next() handles segment rotation; the rest stay within this mapping
+    const EngineEvent* first = next();
+    if (!first) return 0;
+
+    size_t n = 0;
+    out[n++] = first;
+
+    while (n < max && read_pos_ < capacity_ && record_valid(read_pos_)) {
+        out[n++] = &records_[read_pos_++].event;
+        ++records_read_;
+    }
+    return n;
+}
+
+const EngineEvent* JournalReader::next() {
+    for (;;) {
+        if (!records_) {
+            if (!have_segments_)
+                have_segments_ =
+                    journal_segment_range(dir_, first_index_, last_index_) &&
+                    open_segment(first_index_);
+            if (!records_) return nullptr;
+        }
+
+        if (read_pos_ < capacity_) {
+            if (!record_valid(read_pos_))
+                return nullptr;   // end of log or torn tail
+
+            ++records_read_;
+            return &records_[read_pos_++].event;
+        }
+
+        // Segment exhausted: move on if the writer has rotated
+        uint64_t first, last;
+        if (!journal_segment_range(dir_, first, last) ||
+            last <= segment_index_)
+            return nullptr;
+
+        last_index_ = last;
+        if (!open_segment(segment_index_ + 1))
+            return nullptr;
+    }
+}
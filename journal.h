@@ -0,0 +1,149 @@
+#pragma once
+#include "event.h"
+#include <cstddef>
+#include <cstdint>
+
+// =======================
+// Journal Segment Format
+// =======================
+//
+// <dir>/journal-<segment index, 20 digits>.seg
+//
+//   [JournalSegmentHeader, padded to JOURNAL_HEADER_BYTES]
+//   [JournalRecord] * capacity
+//
+// Segments are pre-allocated and zero-filled, so a record with
+// length == 0 marks the end of the log. A CRC mismatch (torn write)
+// is treated the same way, and so is a newest segment whose header never
+// reached the disk but which holds no records.
+
+constexpr uint32_t JOURNAL_MAGIC   = 0x4C4E524A; // "JRNL"
+constexpr uint32_t JOURNAL_VERSION = 1;
+
+constexpr size_t JOURNAL_HEADER_BYTES = 4096;
+
+struct JournalSegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint64_t segment_index;
+    uint64_t first_sequence;
+    uint64_t capacity;           // records
+};
+
+struct alignas(64) JournalRecord {
+    uint32_t    crc;             // CRC32C of `event`
+    uint32_t    length;          // sizeof(EngineEvent); 0 = end of log
+    EngineEvent event;
+};
+
+// =======================
+// Writer
+// =======================
+
+struct JournalConfig {
+    const char* dir              = "journal";
+    uint64_t    segment_records  = 1u << 20;   // 64 MB segments
+
+    // Group commit: msync(MS_SYNC) of the new records once either
+    // threshold is reached. There is no separate fsync: on Linux MS_SYNC
+    // writes the range back and flushes it like fdatasync, and the
+    // blocks were reserved when the segment was created.
+    uint32_t    commit_every     = 4096;       // events (0 = never by count)
+    uint64_t    commit_interval_ns = 1'000'000; // (0 = never by time)
+};
+
+class JournalWriter {
+public:
+    // Resumes after the last valid record of the newest segment in
+    // cfg.dir, or starts segment 0 in an empty directory. A newest
+    // segment left blank by a crash during its creation is started over.
+    explicit JournalWriter(const JournalConfig& cfg);
+    ~JournalWriter();
+
+    // Events must arrive in sequence order.
+    void append(const EngineEvent& ev);
+
+    // Force pending records to stable storage (msync, MS_SYNC).
+    void commit();
+
+    uint64_t last_sequence() const { return last_sequence_; }
+    uint64_t commits() const       { return commits_; }
+
+    // Highest sequence on stable storage: everything up to it survives
+    // a crash, anything after may not
+    uint64_t synced_sequence() const { return synced_sequence_; }
+
+private:
+    void open_segment(uint64_t index, uint64_t first_sequence);
+    void close_segment();
+
+    JournalConfig cfg_;
+
+    int            fd_ = -1;
+    uint8_t*       map_ = nullptr;
+    size_t         map_size_ = 0;
+    JournalRecord* records_ = nullptr;
+
+    uint64_t segment_index_ = 0;
+    uint64_t write_pos_ = 0;       // next record slot in segment
+    uint64_t synced_pos_ = 0;      // records [0, synced_pos_) are durable
+    uint64_t last_sequence_ = 0;
+    uint64_t synced_sequence_ = 0;
+
+    uint64_t last_commit_ns_ = 0;
+    uint64_t commits_ = 0;
+};
+
+// =======================
+// Reader
+// =======================
+
+// Walks all segments in `dir` in order, returning events straight out of
+// the read-only mapping (no copy). Pointers stay valid until the reader
+// moves past their segment.
+class JournalReader {
+public:
+    explicit JournalReader(const char* dir);
+    ~JournalReader();
+
+    // Skip to the first event with sequence > after_sequence.
+    void seek(uint64_t after_sequence);
+
+    // nullptr at end of log (a later call picks up newly written records)
+    const EngineEvent* next();
+
+    // Up to `max` consecutive events, all from one mapped segment so the
+    // pointers stay valid together until the next call. 0 at end of log.
+    size_t next_batch(const EngineEvent** out, size_t max);
+
+    uint64_t records_read() const { return records_read_; }
+
+private:
+    bool open_segment(uint64_t index);
+    void close_segment();
+    bool record_valid(uint64_t pos) const;
+
+    char     dir_[256];
+    uint64_t first_index_ = 0;
+    uint64_t last_index_ = 0;
+    bool     have_segments_ = false;
+
+    int            fd_ = -1;
+    uint8_t*       map_ = nullptr;
+    size_t         map_size_ = 0;
+    JournalRecord* records_ = nullptr;
+    uint64_t       capacity_ = 0;
+    uint64_t       first_sequence_ = 0;
+
+    uint64_t segment_index_ = 0;
+    uint64_t read_pos_ = 0;
+    uint64_t records_read_ = 0;
+};
+
+// Lowest / highest segment index present in `dir`; false if none.
+bool journal_segment_range(const char* dir, uint64_t& first, uint64_t& last);
+
+// Delete every segment in `dir` (start a fresh log).
+void journal_remove_segments(const char* dir);
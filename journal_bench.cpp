@@ -0,0 +1,77 @@
+#include "journal.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+// ------------------------------------------------------------
+// Journal append throughput at different group-commit windows
+// ------------------------------------------------------------
+
+constexpr uint64_t EVENTS = 2'000'000;
+constexpr const char* BENCH_DIR = "journal_bench.d";
+
+static void run(const char* name, uint32_t every, uint64_t interval_ns) {
+    journal_remove_segments(BENCH_DIR);
+
+    JournalConfig cfg;
+    cfg.dir = BENCH_DIR;
+    cfg.segment_records = 1u << 19;     // 32 MB, exercises rotation
+    cfg.commit_every = every;
+    cfg.commit_interval_ns = interval_ns;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    uint64_t commits;
+    {
+        JournalWriter w(cfg);
+
+        for (uint64_t i = 1; i <= EVENTS; ++i) {
+            EngineEvent ev{};
+            ev.header.sequence = i;
+            ev.header.type = EventType::NEW_ORDER;
+            ev.new_order.account_id = i % 1000;
+            ev.new_order.side = static_cast<uint8_t>(i & 1);
+            ev.new_order.price = 1'000'000;
+            ev.new_order.quantity = 1;
+
+            w.append(ev);
+        }
+        w.commit();
+        commits = w.commits();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    // Read back
+    JournalReader r(BENCH_DIR);
+    uint64_t expect = 1;
+    while (const EngineEvent* ev = r.next()) {
+        if (ev->header.sequence != expect++) {
+            std::fprintf(stderr, "%s: sequence gap\n", name);
+            std::abort();
+        }
+    }
+    if (expect != EVENTS + 1) {
+        std::fprintf(stderr, "%s: read back %llu of %llu\n", name,
+                     static_cast<unsigned long long>(expect - 1),
+                     static_cast<unsigned long long>(EVENTS));
+        std::abort();
+    }
+
+    std::printf("[%s] %.0f events/sec, %llu commits\n",
+                name, EVENTS / seconds,
+                static_cast<unsigned long long>(commits));
+}
+
+int main() {
+    run("commit every 64",     64,     0);
+    run("commit every 1024",   1024,   0);
+    run("commit every 16384",  16384,  0);
+    run("commit every 1ms",    0,      1'000'000);
+    run("commit every 10ms",   0,      10'000'000);
+    run("commit at rotation",  0,      0);
+
+    journal_remove_segments(BENCH_DIR);
+    ::rmdir(BENCH_DIR);
+}
@@ -0,0 +1,176 @@
+#include "engine.h"
+#include "instruments.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// ------------------------------------------------------------
+// Next-best lookup after the top ask level empties:
+// linear scan over sell_levels (previous implementation) vs the
+// hierarchical occupancy bitmap vs the SPARSE backend's radix trie.
+// Then the same order flow through DENSE and SPARSE books at several
+// book densities.
+// ------------------------------------------------------------
+
+constexpr uint32_t QUERIES = 2'000'000;
+
+static int32_t next_ask_linear(const OrderBook& book, int32_t idx) {
+    for (int32_t i = idx + 1; i < MAX_TICKS; ++i)
+        if (book.sell_levels[i]) return i;
+    return -1;
+}
+
+static int32_t next_ask_bitmap(const OrderBook& book, int32_t idx) {
+    return book.sell_bits.find_next(idx + 1);
+}
+
+static int32_t next_ask_trie(const OrderBook& book, int32_t idx) {
+    return book.trie.find_next(SELL, idx + 1);
+}
+
+template <typename F>
+static double time_ns_per_query(const OrderBook& book,
+                                const std::vector<int32_t>& from,
+                                F lookup,
+                                int64_t& checksum) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t q = 0; q < QUERIES; ++q)
+        checksum += lookup(book, from[q % from.size()]);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / QUERIES;
+}
+
+static void run(const char* name, int32_t stride) {
+    auto* book = static_cast<OrderBook*>(std::malloc(sizeof(OrderBook)));
+    std::memset(book, 0, sizeof(OrderBook));
+    book->init(0, MAX_TICKS);
+
+    auto* trie_book = static_cast<OrderBook*>(std::calloc(1, sizeof(OrderBook)));
+    trie_book->init(0, MAX_TICKS, TICK_SIZE, false, LevelBackend::SPARSE);
+
+    std::vector<int32_t> occupied;
+    for (int32_t i = 0; i < MAX_TICKS; i += stride) {
+        book->ensure_level(SELL, i);
+        if (trie_book->can_rest(SELL, i))
+            trie_book->ensure_level(SELL, i);
+        occupied.push_back(i);
+    }
+
+    // Query from random occupied levels, as if each had just emptied
+    std::mt19937 rng(42);
+    std::vector<int32_t> from(4096);
+    for (auto& f : from)
+        f = occupied[rng() % occupied.size()];
+
+    int64_t sum_linear = 0;
+    int64_t sum_bitmap = 0;
+    int64_t sum_trie = 0;
+    double linear = time_ns_per_query(*book, from, next_ask_linear, sum_linear);
+    double bitmap = time_ns_per_query(*book, from, next_ask_bitmap, sum_bitmap);
+    double trie = time_ns_per_query(*trie_book, from, next_ask_trie, sum_trie);
+
+    if (sum_linear != sum_bitmap || sum_linear != sum_trie) {
+        std::fprintf(stderr, "%s: lookup mismatch\n", name);
+        std::abort();
+    }
+
+    std::printf("[%s] levels=%zu gap=%d\n", name, occupied.size(), stride);
+    std::printf("  linear: %8.1f ns/lookup\n", linear);
+    std::printf("  bitmap: %8.1f ns/lookup\n", bitmap);
+    std::printf("  trie:   %8.1f ns/lookup (%u nodes)\n", trie,
+                trie_book->trie.node_live);
+
+    std::free(book);
+    std::free(trie_book);
+}
+
+// ------------------------------------------------------------
+// Limit orders priced uniformly over `spread` ticks: a narrow spread
+// gives a dense book of deep levels, a wide one a sparse book of
+// shallow levels scattered over the band.
+// ------------------------------------------------------------
+
+constexpr uint64_t FLOW_EVENTS = 1'000'000;
+constexpr uint64_t FLOW_ACCOUNTS = 1000;
+
+static double flow_ns_per_event(LevelBackend levels, int64_t spread) {
+    auto* state =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    InstrumentSpec spec{0, TICK_SIZE, 1'000'000,
+                        1'000'000 + int64_t{band_capacity(levels)} * TICK_SIZE,
+                        false, levels};
+    init_instrument(*state, spec);
+    MatchingEngine engine(*state);
+
+    for (uint64_t i = 0; i < FLOW_ACCOUNTS; ++i) {
+        uint32_t slot = state->accounts.open(i);
+        state->accounts.hot[slot].base_available  = 1'000'000'000'000;
+        state->accounts.hot[slot].quote_available = 1'000'000'000'000;
+    }
+
+    std::mt19937_64 rng(31);
+    std::vector<EngineEvent> events(FLOW_EVENTS);
+    for (uint64_t i = 0; i < FLOW_EVENTS; ++i) {
+        EngineEvent& ev = events[i];
+        ev = EngineEvent{};
+        ev.header.sequence = i + 1;
+
+        uint64_t issued = i;
+        if (issued > 0 && rng() % 4 == 0) {
+            ev.header.type = EventType::CANCEL;
+            ev.cancel.order_id = 1 + rng() % issued;
+        } else {
+            ev.header.type = EventType::NEW_ORDER;
+            ev.new_order.account_id = rng() % FLOW_ACCOUNTS;
+            ev.new_order.side       = static_cast<uint8_t>(rng() % 2);
+            ev.new_order.price      =
+                1'000'000 + static_cast<int64_t>(
+                                rng() % static_cast<uint64_t>(spread));
+            ev.new_order.quantity   = static_cast<int64_t>(rng() % 10) + 1;
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const EngineEvent& ev : events)
+        engine.apply(ev);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::free(state);
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / FLOW_EVENTS;
+}
+
+// Best of alternating rounds, so first-touch page faults don't land on
+// one backend only
+static void run_flow(const char* name, int64_t spread) {
+    double dense  = 1e300;
+    double sparse = 1e300;
+    for (int round = 0; round < 2; ++round) {
+        dense  = std::min(dense, flow_ns_per_event(LevelBackend::DENSE, spread));
+        sparse = std::min(sparse, flow_ns_per_event(LevelBackend::SPARSE, spread));
+    }
+
+    std::printf("[flow %s] spread=%lld ticks\n", name,
+                static_cast<long long>(spread));
+    std::printf("  dense:  %8.1f ns/event\n", dense);
+    std::printf("  sparse: %8.1f ns/event\n", sparse);
+}
+
+int main() {
+    run("dense", 1);
+    run("medium", 64);
+    run("sparse", 5'000);
+    run("very sparse", 40'000);
+
+    run_flow("deep", 100);
+    run_flow("medium", 5'000);
+    run_flow("shallow", MAX_TICKS);
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+
+// =======================
+// Level Occupancy Bitmap
+// =======================
+//
+// Three-level 64-ary bitmap over [0, N). A bit in l1 / l2 is set iff the
+// word below it is non-zero, so next/prev occupied index is at most three
+// ctz/clz steps regardless of how many empty ticks lie in between.
+
+template <uint32_t N>
+struct LevelBitmap {
+    static constexpr uint32_t L0_WORDS = (N + 63) / 64;
+    static constexpr uint32_t L1_WORDS = (L0_WORDS + 63) / 64;
+
+    static_assert(L1_WORDS <= 64, "bitmap supports at most 2^18 entries");
+
+    uint64_t l0[L0_WORDS];
+    uint64_t l1[L1_WORDS];
+    uint64_t l2;
+
+    void clear_all() {
+        for (uint32_t i = 0; i < L0_WORDS; ++i) l0[i] = 0;
+        for (uint32_t i = 0; i < L1_WORDS; ++i) l1[i] = 0;
+        l2 = 0;
+    }
+
+    inline void set(int32_t idx) {
+        uint32_t i = static_cast<uint32_t>(idx);
+        l0[i >> 6]  |= bit(i & 63);
+        l1[i >> 12] |= bit((i >> 6) & 63);
+        l2          |= bit(i >> 12);
+    }
+
+    inline void clear(int32_t idx) {
+        uint32_t i = static_cast<uint32_t>(idx);
+        if ((l0[i >> 6] &= ~bit(i & 63)) != 0) return;
+        if ((l1[i >> 12] &= ~bit((i >> 6) & 63)) != 0) return;
+        l2 &= ~bit(i >> 12);
+    }
+
+    inline bool test(int32_t idx) const {
+        uint32_t i = static_cast<uint32_t>(idx);
+        return (l0[i >> 6] & bit(i & 63)) != 0;
+    }
+
+    // Smallest set index >= idx, or -1.
+    inline int32_t find_next(int32_t idx) const {
+        if (idx < 0) idx = 0;
+        if (idx >= static_cast<int32_t>(N)) return -1;
+
+        uint32_t i = static_cast<uint32_t>(idx);
+        uint32_t w = i >> 6;
+
+        uint64_t m = l0[w] & (~0ull << (i & 63));
+        if (m) return static_cast<int32_t>((w << 6) + ctz(m));
+
+        uint32_t w1 = w + 1;
+        if (w1 >= L0_WORDS) return -1;
+
+        uint32_t j = w1 >> 6;
+        m = l1[j] & (~0ull << (w1 & 63));
+        if (m) return first_in_l1_word(j, m);
+
+        uint32_t j1 = j + 1;
+        if (j1 >= L1_WORDS) return -1;
+
+        m = l2 & (~0ull << j1);
+        if (!m) return -1;
+
+        uint32_t jj = ctz(m);
+        return first_in_l1_word(jj, l1[jj]);
+    }
+
+    // Largest set index <= idx, or -1.
+    inline int32_t find_prev(int32_t idx) const {
+        if (idx < 0) return -1;
+        if (idx >= static_cast<int32_t>(N)) idx = static_cast<int32_t>(N) - 1;
+
+        uint32_t i = static_cast<uint32_t>(idx);
+        uint32_t w = i >> 6;
+
+        uint64_t m = l0[w] & up_to(i & 63);
+        if (m) return static_cast<int32_t>((w << 6) + msb(m));
+
+        if (w == 0) return -1;
+        uint32_t w1 = w - 1;
+
+        uint32_t j = w1 >> 6;
+        m = l1[j] & up_to(w1 & 63);
+        if (m) return last_in_l1_word(j, m);
+
+        if (j == 0) return -1;
+        uint32_t j1 = j - 1;
+
+        m = l2 & up_to(j1);
+        if (!m) return -1;
+
+        uint32_t jj = msb(m);
+        return last_in_l1_word(jj, l1[jj]);
+    }
+
+private:
+    static inline uint64_t bit(uint32_t b) { return 1ull << b; }
+
+    // bits [0, b]
+    static inline uint64_t up_to(uint32_t b) {
+        return b == 63 ? ~0ull : (bit(b + 1) - 1);
+    }
+
+    static inline uint32_t ctz(uint64_t m) {
+        return static_cast<uint32_t>(__builtin_ctzll(m));
+    }
+
+    static inline uint32_t msb(uint64_t m) {
+        return 63u - static_cast<uint32_t>(__builtin_clzll(m));
+    }
+
+    inline int32_t first_in_l1_word(uint32_t j, uint64_t m) const {
+        uint32_t w = (j << 6) + ctz(m);
+        return static_cast<int32_t>((w << 6) + ctz(l0[w]));
+    }
+
+    inline int32_t last_in_l1_word(uint32_t j, uint64_t m) const {
+        uint32_t w = (j << 6) + msb(m);
+        return static_cast<int32_t>((w << 6) + msb(l0[w]));
+    }
+};
@@ -0,0 +1,211 @@
+#include "level_trie.h"
+#include "engine_common.h"
+
+static inline uint32_t ctz(uint64_t m) {
+    return static_cast<uint32_t>(__builtin_ctzll(m));
+}
+
+static inline uint32_t msb(uint64_t m) {
+    return 63u - static_cast<uint32_t>(__builtin_clzll(m));
+}
+
+// Digits [0, level) of idx with `c` appended as digit `level`
+static inline uint32_t prefix_with(int32_t idx, uint32_t level, uint32_t c) {
+    uint32_t shift = TRIE_FANOUT_BITS * (TRIE_DEPTH - level);
+    uint32_t above = shift >= 32 ? 0 : static_cast<uint32_t>(idx) >> shift;
+    return (above << TRIE_FANOUT_BITS) | c;
+}
+
+// =======================
+// Node Pool
+// =======================
+
+void LevelTrie::init() {
+    node_top = 1;
+    node_free_head = 0;
+    node_live = 0;
+    root[0] = alloc_node();
+    root[1] = alloc_node();
+}
+
+// Free nodes have every child cleared except the free-list link
+uint32_t LevelTrie::alloc_node() {
+    uint32_t h = node_free_head;
+
+    if (h) {
+        node_free_head = nodes[h].child[0];
+    } else {
+#ifndef ENGINE_PERF_MODE
+        if (node_top >= TRIE_NODES)
+            ENGINE_ABORT("trie node pool exhausted");
+#endif
+        h = node_top++;
+    }
+
+    nodes[h].mask = 0;
+    nodes[h].child[0] = 0;
+    ++node_live;
+    return h;
+}
+
+void LevelTrie::free_node(uint32_t h) {
+    nodes[h].mask = 0;
+    nodes[h].child[0] = node_free_head;
+    node_free_head = h;
+    --node_live;
+}
+
+// =======================
+// Insert / Erase
+// =======================
+
+uint32_t LevelTrie::nodes_needed(uint8_t side, int32_t idx) const {
+    const TrieNode* n = &nodes[root[side]];
+    for (uint32_t level = 0; level + 1 < TRIE_DEPTH; ++level) {
+        uint32_t d = digit(idx, level);
+        if (!(n->mask & bit(d))) return TRIE_DEPTH - 1 - level;
+        n = &nodes[n->child[d]];
+    }
+    return 0;
+}
+
+void LevelTrie::insert(uint8_t side, int32_t idx, uint32_t handle) {
+    uint32_t h = root[side];
+    for (uint32_t level = 0; level + 1 < TRIE_DEPTH; ++level) {
+        uint32_t d = digit(idx, level);
+        if (!(nodes[h].mask & bit(d))) {
+            uint32_t c = alloc_node();
+            nodes[h].child[d] = c;
+            nodes[h].mask |= bit(d);
+        }
+        h = nodes[h].child[d];
+    }
+
+    uint32_t d = digit(idx, TRIE_DEPTH - 1);
+    nodes[h].child[d] = handle;
+    nodes[h].mask |= bit(d);
+}
+
+void LevelTrie::erase(uint8_t side, int32_t idx) {
+    uint32_t path[TRIE_DEPTH];
+    uint32_t h = root[side];
+    for (uint32_t level = 0; level < TRIE_DEPTH; ++level) {
+        path[level] = h;
+        if (level + 1 < TRIE_DEPTH) h = nodes[h].child[digit(idx, level)];
+    }
+
+    uint32_t d = digit(idx, TRIE_DEPTH - 1);
+    TrieNode& leaf = nodes[path[TRIE_DEPTH - 1]];
+    leaf.child[d] = 0;
+    leaf.mask &= ~bit(d);
+
+    // Unlink nodes left empty, bottom up
+    for (uint32_t level = TRIE_DEPTH - 1; level > 0; --level) {
+        if (nodes[path[level]].mask) return;
+
+        free_node(path[level]);
+        TrieNode& parent = nodes[path[level - 1]];
+        uint32_t pd = digit(idx, level - 1);
+        parent.child[pd] = 0;
+        parent.mask &= ~bit(pd);
+    }
+}
+
+// =======================
+// Next / Previous
+// =======================
+//
+// Descend along idx as far as it exists, then climb until some node has
+// a present child past idx's digit, and take that subtree's extreme.
+
+int32_t LevelTrie::min_below(uint32_t h, uint32_t level,
+                             uint32_t prefix) const {
+    for (;; ++level) {
+        uint32_t c = ctz(nodes[h].mask);
+        prefix = (prefix << TRIE_FANOUT_BITS) | c;
+        if (level + 1 == TRIE_DEPTH) return static_cast<int32_t>(prefix);
+        h = nodes[h].child[c];
+    }
+}
+
+int32_t LevelTrie::max_below(uint32_t h, uint32_t level,
+                             uint32_t prefix) const {
+    for (;; ++level) {
+        uint32_t c = msb(nodes[h].mask);
+        prefix = (prefix << TRIE_FANOUT_BITS) | c;
+        if (level + 1 == TRIE_DEPTH) return static_cast<int32_t>(prefix);
+        h = nodes[h].child[c];
+    }
+}
+
+int32_t LevelTrie::find_next(uint8_t side, int32_t idx) const {
+    if (idx < 0) idx = 0;
+    if (idx >= TRIE_KEYS) return -1;
+
+    uint32_t path[TRIE_DEPTH];
+    uint32_t h = root[side];
+    uint32_t level = 0;
+
+    for (;; ++level) {
+        path[level] = h;
+        const TrieNode& n = nodes[h];
+        uint32_t d = digit(idx, level);
+
+        if (level + 1 == TRIE_DEPTH) {
+            uint64_t m = n.mask & ~(bit(d) - 1);
+            if (m) return (idx & ~63) | static_cast<int32_t>(ctz(m));
+            break;
+        }
+        if (!(n.mask & bit(d))) break;
+        h = n.child[d];
+    }
+
+    for (int32_t l = static_cast<int32_t>(level); l >= 0; --l) {
+        uint32_t ul = static_cast<uint32_t>(l);
+        uint32_t d = digit(idx, ul);
+        uint64_t m = (d == 63) ? 0 : nodes[path[ul]].mask & (~0ull << (d + 1));
+        if (!m) continue;
+
+        uint32_t c = ctz(m);
+        uint32_t p = prefix_with(idx, ul, c);
+        if (ul + 1 == TRIE_DEPTH) return static_cast<int32_t>(p);
+        return min_below(nodes[path[ul]].child[c], ul + 1, p);
+    }
+    return -1;
+}
+
+int32_t LevelTrie::find_prev(uint8_t side, int32_t idx) const {
+    if (idx < 0) return -1;
+    if (idx >= TRIE_KEYS) idx = TRIE_KEYS - 1;
+
+    uint32_t path[TRIE_DEPTH];
+    uint32_t h = root[side];
+    uint32_t level = 0;
+
+    for (;; ++level) {
+        path[level] = h;
+        const TrieNode& n = nodes[h];
+        uint32_t d = digit(idx, level);
+
+        if (level + 1 == TRIE_DEPTH) {
+            uint64_t m = n.mask & (d == 63 ? ~0ull : bit(d + 1) - 1);
+            if (m) return (idx & ~63) | static_cast<int32_t>(msb(m));
+            break;
+        }
+        if (!(n.mask & bit(d))) break;
+        h = n.child[d];
+    }
+
+    for (int32_t l = static_cast<int32_t>(level); l >= 0; --l) {
+        uint32_t ul = static_cast<uint32_t>(l);
+        uint32_t d = digit(idx, ul);
+        uint64_t m = nodes[path[ul]].mask & (bit(d) - 1);
+        if (!m) continue;
+
+        uint32_t c = msb(m);
+        uint32_t p = prefix_with(idx, ul, c);
+        if (ul + 1 == TRIE_DEPTH) return static_cast<int32_t>(p);
+        return max_below(nodes[path[ul]].child[c], ul + 1, p);
+    }
+    return -1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+
+// =======================
+// Sparse Level Index
+// =======================
+//
+// 64-ary radix trie over 30-bit price indices, one root per side, for
+// books whose band is too wide for the direct-indexed arrays. Each node
+// keeps a child mask, so next / previous occupied index follows the same
+// ctz/clz steps as LevelBitmap, but memory follows the occupied levels
+// rather than the band width. Leaves hold level_pool handles.
+//
+// Nodes come from a fixed pool addressed by 32-bit handles (0 = none),
+// so the trie stays position-independent like the rest of EngineState.
+
+constexpr uint32_t TRIE_FANOUT_BITS = 6;
+constexpr uint32_t TRIE_DEPTH       = 5;
+constexpr int32_t  TRIE_KEYS        = 1 << (TRIE_FANOUT_BITS * TRIE_DEPTH);
+constexpr uint32_t TRIE_NODES       = 1u << 15;
+
+struct TrieNode {
+    uint64_t mask;          // which children are present
+    uint32_t child[64];     // inner: node handle, leaf: level handle;
+                            // child[0] links the free list while unused
+};
+
+struct LevelTrie {
+    TrieNode nodes[TRIE_NODES];     // slot 0 is the null handle
+    uint32_t root[2];               // per side, allocated by init()
+    uint32_t node_top;              // next never-used slot
+    uint32_t node_free_head;        // LIFO of released slots
+    uint32_t node_live;             // allocated, including the roots
+
+    void init();
+
+    inline uint32_t get(uint8_t side, int32_t idx) const {
+        const TrieNode* n = &nodes[root[side]];
+        for (uint32_t level = 0; level + 1 < TRIE_DEPTH; ++level) {
+            uint32_t d = digit(idx, level);
+            if (!(n->mask & bit(d))) return 0;
+            n = &nodes[n->child[d]];
+        }
+        return n->child[digit(idx, TRIE_DEPTH - 1)];
+    }
+
+    // Nodes an insert of `idx` would allocate
+    uint32_t nodes_needed(uint8_t side, int32_t idx) const;
+
+    inline bool can_insert(uint8_t side, int32_t idx) const {
+        return nodes_needed(side, idx) <= TRIE_NODES - 1 - node_live;
+    }
+
+    // `idx` must be absent and can_insert() true
+    void insert(uint8_t side, int32_t idx, uint32_t handle);
+
+    // Drops `idx` and any node it leaves empty (roots stay)
+    void erase(uint8_t side, int32_t idx);
+
+    // Smallest present index >= idx / largest <= idx, or -1
+    int32_t find_next(uint8_t side, int32_t idx) const;
+    int32_t find_prev(uint8_t side, int32_t idx) const;
+
+    // Calls f(const TrieNode&) for every node on the path to `idx`
+    template <class F>
+    inline void visit_path(uint8_t side, int32_t idx, F&& f) const {
+        const TrieNode* n = &nodes[root[side]];
+        for (uint32_t level = 0;; ++level) {
+            f(*n);
+            if (level + 1 == TRIE_DEPTH) return;
+            uint32_t d = digit(idx, level);
+            if (!(n->mask & bit(d))) return;
+            n = &nodes[n->child[d]];
+        }
+    }
+
+    static inline uint32_t digit(int32_t idx, uint32_t level) {
+        uint32_t shift = TRIE_FANOUT_BITS * (TRIE_DEPTH - 1 - level);
+        return (static_cast<uint32_t>(idx) >> shift) & 63u;
+    }
+
+    static inline uint64_t bit(uint32_t b) { return 1ull << b; }
+
+private:
+    uint32_t alloc_node();
+    void     free_node(uint32_t h);
+
+    int32_t min_below(uint32_t h, uint32_t level, uint32_t prefix) const;
+    int32_t max_below(uint32_t h, uint32_t level, uint32_t prefix) const;
+};
@@ -1,124 +1,277 @@
 #include "order_book.h"
 #include "engine_common.h"
+#include "perf.h"
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 
-void OrderBook::init(int64_t min_p, int64_t max_p) {
+void OrderBook::init(int64_t min_p, int64_t max_p, int64_t tick,
+                     bool recenter_band, LevelBackend levels) {
+    backend = levels;
     min_price = min_p;
-    max_price = max_p;
+    tick_size = tick;
+    ticks = static_cast<int32_t>(std::min<int64_t>((max_p - min_p) / tick,
+                                                   band_capacity(levels)));
+    max_price = min_p + ticks * tick;
+    auto_recenter = recenter_band ? 1 : 0;
 
     for (int i = 0; i < MAX_TICKS; ++i) {
-        buy_levels[i]  = nullptr;
-        sell_levels[i] = nullptr;
+        buy_levels[i]  = 0;
+        sell_levels[i] = 0;
     }
 
+    buy_bits.clear_all();
+    sell_bits.clear_all();
+
     best_bid = -1;
     best_ask = -1;
-    level_pool_top = 0;
+    best_bid_level = 0;
+    best_ask_level = 0;
+    level_pool_top = 1;
+    level_free_head = 0;
+
+    if (backend == LevelBackend::SPARSE)
+        trie.init();
 }
 
-PriceLevel* OrderBook::ensure_level(uint8_t side, int32_t idx) {
+PriceLevel* OrderBook::ensure_level(uint8_t side, int32_t idx,
+                                    LevelPoolCounters* pool) {
 #ifndef ENGINE_PERF_MODE
-    if (idx < 0 || idx >= MAX_TICKS)
+    if (idx < 0 || idx >= ticks)
         ENGINE_ABORT("price index out of range");
 #endif
 
-    PriceLevel** levels = (side == BUY) ? buy_levels : sell_levels;
+    uint32_t h = handle(side, idx);
+
+    if (!h) {
+        h = level_free_head;
 
-    if (!levels[idx]) {
+        if (h) {
+            // LIFO: the most recently emptied level is the warmest
+            level_free_head = level_pool[h].next_free;
+            if (pool) pool->reused++;
+        } else {
+            // A DENSE book has one slot per (side, tick), so the pool
+            // cannot run dry; a SPARSE one is held back by can_rest().
 #ifndef ENGINE_PERF_MODE
-        if (level_pool_top >= (MAX_TICKS * 2))
-            ENGINE_ABORT("price level pool exhausted");
+            if (level_pool_top >= LEVEL_POOL_SIZE)
+                ENGINE_ABORT("price level pool exhausted");
 #endif
-        // In PERF mode, silently reuse last slot (safe, deterministic enough)
-        PriceLevel* lvl = &level_pool[
-            (level_pool_top < (MAX_TICKS * 2))
-                ? level_pool_top++
-                : (MAX_TICKS * 2 - 1)
-        ];
+            h = level_pool_top++;
+            if (pool) pool->high_water = h;
+        }
+        if (pool) pool->allocs++;
 
+        PriceLevel* lvl = &level_pool[h];
         lvl->head = 0;
         lvl->tail = 0;
-        levels[idx] = lvl;
+        lvl->count = 0;
+        lvl->next_free = 0;
+        lvl->quantity = 0;
+
+        if (backend == LevelBackend::SPARSE) {
+            trie.insert(side, idx, h);
+        } else {
+            ((side == BUY) ? buy_levels : sell_levels)[idx] = h;
+            ((side == BUY) ? buy_bits : sell_bits).set(idx);
+        }
     }
 
-    return levels[idx];
+    return &level_pool[h];
+}
+
+void OrderBook::add_order(uint8_t side, int32_t idx, uint32_t oid,
+                          Orders& orders, LevelPoolCounters* pool) {
+    PriceLevel* lvl = ensure_level(side, idx, pool);
+
+    orders.hot[oid].prev = lvl->tail;
+    orders.hot[oid].next = 0;
+
+    if (lvl->tail)
+        orders.hot[lvl->tail].next = oid;
+    else
+        lvl->head = oid;
+
+    lvl->tail = oid;
+    lvl->count++;
+    lvl->quantity += orders.hot[oid].qty_remaining;
+
+    update_best_on_insert(side, idx, static_cast<uint32_t>(lvl - level_pool));
 }
 
-void OrderBook::add_order(uint8_t side, int32_t idx, uint64_t order_id) {
-    PriceLevel* lvl = ensure_level(side, idx);
-    uint32_t size = lvl->tail - lvl->head;
+void OrderBook::remove_order(uint8_t side, int32_t idx, uint32_t oid,
+                             Orders& orders, LevelPoolCounters* pool) {
+    uint32_t h = handle(side, idx);
+    PriceLevel* lvl = h ? &level_pool[h] : nullptr;
 
 #ifndef ENGINE_PERF_MODE
-    if (size >= MAX_LEVEL_ORDERS)
-        ENGINE_ABORT("price level overflow");
+    if (!lvl)
+        ENGINE_ABORT("remove from empty level");
 #endif
 
-    // PERF mode: overwrite oldest (bounded ring buffer)
-    if (size >= MAX_LEVEL_ORDERS) {
-        lvl->head++;
-    }
+    uint32_t p = orders.hot[oid].prev;
+    uint32_t n = orders.hot[oid].next;
 
-    lvl->order_ids[lvl->tail % MAX_LEVEL_ORDERS] =
-        static_cast<uint32_t>(order_id);
-    lvl->tail++;
+    if (p) orders.hot[p].next = n; else lvl->head = n;
+    if (n) orders.hot[n].prev = p; else lvl->tail = p;
 
-    update_best_on_insert(side, idx);
-}
+    orders.hot[oid].prev = 0;
+    orders.hot[oid].next = 0;
+
+    // Zero for a filled order: its fills already came off the level
+    lvl->quantity -= orders.hot[oid].qty_remaining;
 
-// Lazy cancel: nothing to do here yet (order state marks CANCELLED)
-void OrderBook::cancel_lazy(uint8_t /*side*/, int32_t /*idx*/, uint64_t /*order_id*/) {
-    // no-op by design
+    if (--lvl->count == 0) {
+        lvl->next_free = level_free_head;
+        level_free_head = h;
+        if (pool) pool->frees++;
+
+        if (backend == LevelBackend::SPARSE) {
+            trie.erase(side, idx);
+        } else {
+            ((side == BUY) ? buy_levels : sell_levels)[idx] = 0;
+            ((side == BUY) ? buy_bits : sell_bits).clear(idx);
+        }
+        update_best_on_level_empty(side, idx);
+    }
 }
 
-void OrderBook::update_best_on_insert(uint8_t side, int32_t idx) {
+void OrderBook::update_best_on_insert(uint8_t side, int32_t idx,
+                                     uint32_t h) {
     if (side == BUY) {
-        if (best_bid < idx) best_bid = idx;
+        if (best_bid < idx) { best_bid = idx; best_bid_level = h; }
     } else {
-        if (best_ask == -1 || best_ask > idx) best_ask = idx;
+        if (best_ask == -1 || best_ask > idx) { best_ask = idx; best_ask_level = h; }
     }
 }
 
+// Next-best lookup through the occupancy bitmap / trie masks: a few
+// ctz/clz steps however wide the gap to the next occupied level is.
 void OrderBook::update_best_on_level_empty(uint8_t side, int32_t idx) {
     if (side == BUY && best_bid == idx) {
-        for (int32_t i = idx - 1; i >= 0; --i) {
-            if (buy_levels[i]) {
-                best_bid = i;
-                return;
-            }
-        }
-        best_bid = -1;
+        best_bid = prev_level(BUY, idx - 1);
+        best_bid_level = (best_bid == -1) ? 0 : handle(BUY, best_bid);
     }
 
     if (side == SELL && best_ask == idx) {
-        for (int32_t i = idx + 1; i < MAX_TICKS; ++i) {
-            if (sell_levels[i]) {
-                best_ask = i;
-                return;
-            }
-        }
-        best_ask = -1;
+        best_ask = next_level(SELL, idx + 1);
+        best_ask_level = (best_ask == -1) ? 0 : handle(SELL, best_ask);
+    }
+}
+
+size_t OrderBook::top_levels(uint8_t side, DepthLevel* out,
+                             size_t n) const {
+    size_t k = 0;
+    int32_t idx = (side == BUY) ? best_bid : best_ask;
+
+    while (k < n && idx != -1) {
+        const PriceLevel& lvl = level_pool[handle(side, idx)];
+        out[k++] = {index_to_price(idx), lvl.quantity, lvl.count};
+        idx = (side == BUY) ? prev_level(BUY, idx - 1)
+                            : next_level(SELL, idx + 1);
     }
+    return k;
 }
 
 bool OrderBook::logical_equals(const OrderBook& o) const {
     if (best_bid != o.best_bid) return false;
     if (best_ask != o.best_ask) return false;
 
-    for (int i = 0; i < MAX_TICKS; ++i) {
-        const PriceLevel* a = buy_levels[i];
-        const PriceLevel* b = o.buy_levels[i];
+    if (min_price != o.min_price || tick_size != o.tick_size ||
+        ticks != o.ticks || backend != o.backend)
+        return false;
+
+    // Walk the occupied levels of both books in step
+    for (uint8_t side = BUY; side <= SELL; ++side) {
+        int32_t i = next_level(side, 0);
+        int32_t j = o.next_level(side, 0);
+
+        for (; i != -1 || j != -1;
+             i = next_level(side, i + 1), j = o.next_level(side, j + 1)) {
+            if (i != j) return false;
+            if (std::memcmp(level(side, i), o.level(side, j),
+                            sizeof(PriceLevel)) != 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// =======================
+// Band Recentering
+// =======================
+
+bool OrderBook::recenter(int64_t price) {
+    if ((price - min_price) % tick_size != 0)
+        return false;
+
+    // Candidate shifts s (in ticks) put the band at min_price + s * tick
+    const int64_t rel = (price - min_price) / tick_size;
+    int64_t lo = rel - ticks + 1;
+    int64_t hi = rel;
+
+    // Prices stay positive: s >= ceil((1 - min_price) / tick)
+    const int64_t floor_num = 1 - min_price;
+    lo = std::max(lo, floor_num > 0 ? (floor_num + tick_size - 1) / tick_size
+                                    : floor_num / tick_size);
 
-        if ((a == nullptr) != (b == nullptr)) return false;
-        if (a && std::memcmp(a, b, sizeof(PriceLevel)) != 0)
-            return false;
+    // ... and max_price must not overflow
+    hi = std::min(hi, (INT64_MAX - max_price) / tick_size);
 
-        a = sell_levels[i];
-        b = o.sell_levels[i];
+    // Occupied levels must stay inside [s, s + ticks)
+    int32_t first = -1;
+    int32_t last  = -1;
+    for (uint8_t side = BUY; side <= SELL; ++side) {
+        int32_t f = next_level(side, 0);
+        if (f == -1) continue;
+        int32_t l = prev_level(side, ticks - 1);
+        first = (first == -1) ? f : std::min(first, f);
+        last  = std::max(last, l);
+    }
+
+    // Trie keys are positions; moving them means rebuilding the trie
+    if (backend == LevelBackend::SPARSE && first != -1)
+        return false;
+
+    if (first != -1) {
+        lo = std::max<int64_t>(lo, last - ticks + 1);
+        hi = std::min<int64_t>(hi, first);
+    }
+
+    if (lo > hi)
+        return false;
+
+    const int64_t shift = std::clamp<int64_t>(rel - ticks / 2, lo, hi);
+    if (shift == 0)
+        return true;
 
-        if ((a == nullptr) != (b == nullptr)) return false;
-        if (a && std::memcmp(a, b, sizeof(PriceLevel)) != 0)
-            return false;
+    // Move the handles; only [first, last] can be non-zero
+    if (first != -1) {
+        const size_t n = static_cast<size_t>(last - first + 1);
+        const int32_t to = static_cast<int32_t>(first - shift);
+        std::memmove(&buy_levels[to], &buy_levels[first], n * sizeof(uint32_t));
+        std::memmove(&sell_levels[to], &sell_levels[first], n * sizeof(uint32_t));
+
+        // Zero what the move vacated
+        for (int32_t i = first; i <= last; ++i) {
+            if (i >= to && i < to + static_cast<int32_t>(n)) continue;
+            buy_levels[i]  = 0;
+            sell_levels[i] = 0;
+        }
+
+        buy_bits.clear_all();
+        sell_bits.clear_all();
+        for (int32_t i = to; i < to + static_cast<int32_t>(n); ++i) {
+            if (buy_levels[i])  buy_bits.set(i);
+            if (sell_levels[i]) sell_bits.set(i);
+        }
     }
 
+    if (best_bid != -1) best_bid = static_cast<int32_t>(best_bid - shift);
+    if (best_ask != -1) best_ask = static_cast<int32_t>(best_ask - shift);
+
+    min_price += shift * tick_size;
+    max_price += shift * tick_size;
     return true;
-}
\ No newline at end of file
+}
@@ -1,46 +1,186 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include "orders.h"
+#include "level_bitmap.h"
+#include "level_trie.h"
+#include "perf.h"   // LevelPoolCounters
 
 // ---- Config ----
+// TICK_SIZE is the default tick; each book carries its own tick_size and
+// band width (at most MAX_TICKS, the index capacity).
 constexpr int32_t TICK_SIZE = 1;
 constexpr int32_t MAX_TICKS = 100'000;
-constexpr uint32_t MAX_LEVEL_ORDERS = 10'000;
 
 constexpr uint8_t BUY  = 0;
 constexpr uint8_t SELL = 1;
 
+// Level slots are handed out from level_pool; slot 0 is the null handle.
+constexpr uint32_t LEVEL_POOL_SIZE = MAX_TICKS * 2 + 1;
+
+// Price index behind a book, chosen per instrument
+enum class LevelBackend : uint8_t {
+    DENSE  = 0,   // direct-indexed arrays + bitmaps, band <= MAX_TICKS
+    SPARSE = 1    // radix trie, band <= TRIE_KEYS ticks
+};
+
+constexpr int32_t band_capacity(LevelBackend b) {
+    return b == LevelBackend::SPARSE ? TRIE_KEYS : MAX_TICKS;
+}
+
+// FIFO of resting orders, linked through Orders::prev / Orders::next.
+// Levels carry no per-order storage, so depth is bounded only by Orders.
+// `quantity` and `count` are kept in step on add, fill and remove, so
+// market data never walks the FIFO.
 struct PriceLevel {
-    uint32_t order_ids[MAX_LEVEL_ORDERS];
-    uint32_t head;
-    uint32_t tail;
+    uint32_t head;        // oldest order (0 = empty)
+    uint32_t tail;        // newest order
+    uint32_t count;       // resting orders
+    uint32_t next_free;   // free-list link while the slot is unused
+    int64_t  quantity;    // sum of their qty_remaining
+};
+
+// One row of a depth snapshot
+struct DepthLevel {
+    int64_t  price;
+    int64_t  quantity;
+    uint32_t orders;
+};
+
+// Tick policies for the price <-> index conversions. RuntimeTicks reads
+// the book's tick_size; FixedTicks<N> makes it a constant so the divide
+// and multiply fold away on books configured with that tick.
+struct RuntimeTicks {
+    static inline int64_t tick(int64_t runtime) { return runtime; }
+};
+
+template <int64_t N>
+struct FixedTicks {
+    static_assert(N > 0, "tick size must be positive");
+    static constexpr int64_t tick(int64_t) { return N; }
 };
 
 struct OrderBook {
-    PriceLevel* buy_levels[MAX_TICKS];
-    PriceLevel* sell_levels[MAX_TICKS];
+    // DENSE: price index -> level_pool slot (0 = no level). 32-bit handles
+    // keep the index half the size of pointers and the book
+    // position-independent.
+    uint32_t buy_levels[MAX_TICKS];
+    uint32_t sell_levels[MAX_TICKS];
 
     int32_t best_bid;
     int32_t best_ask;
 
+    // Handles of the best levels, so matching never walks the index
+    uint32_t best_bid_level;
+    uint32_t best_ask_level;
+
+    // DENSE: occupied-level index, kept in step with buy_levels / sell_levels
+    LevelBitmap<MAX_TICKS> buy_bits;
+    LevelBitmap<MAX_TICKS> sell_bits;
+
     int64_t min_price;
-    int64_t max_price;
+    int64_t max_price;      // exclusive: min_price + ticks * tick_size
+    int64_t tick_size;
+    int32_t ticks;          // band width in ticks, <= MAX_TICKS
+    uint8_t auto_recenter;  // slide the band when a resting price leaves it
+    LevelBackend backend;
+
+    PriceLevel level_pool[LEVEL_POOL_SIZE];
+    uint32_t   level_pool_top;     // next never-used slot
+    uint32_t   level_free_head;    // LIFO of released slots (0 = empty)
 
-    PriceLevel level_pool[MAX_TICKS * 2];
-    uint32_t   level_pool_top;
+    // SPARSE: price index -> level_pool slot. Untouched (zero) when DENSE.
+    LevelTrie trie;
 
-    void init(int64_t min_p, int64_t max_p);
+    void init(int64_t min_p, int64_t max_p, int64_t tick = TICK_SIZE,
+              bool recenter = false,
+              LevelBackend levels = LevelBackend::DENSE);
 
+    template <class Ticks = RuntimeTicks>
     inline int32_t price_to_index(int64_t price) const {
-        return static_cast<int32_t>((price - min_price) / TICK_SIZE);
+        return static_cast<int32_t>(
+            (price - min_price) / Ticks::tick(tick_size));
+    }
+
+    template <class Ticks = RuntimeTicks>
+    inline int64_t index_to_price(int32_t idx) const {
+        return min_price + idx * Ticks::tick(tick_size);
+    }
+
+    // Inside the band and on the tick grid
+    template <class Ticks = RuntimeTicks>
+    inline bool indexable(int64_t price) const {
+        return price >= min_price && price < max_price &&
+               (price - min_price) % Ticks::tick(tick_size) == 0;
     }
 
-    PriceLevel* ensure_level(uint8_t side, int32_t idx);
-    void add_order(uint8_t side, int32_t idx, uint64_t order_id);
-    void cancel_lazy(uint8_t side, int32_t idx, uint64_t order_id);
+    // Slides the band by whole ticks so that `price` (on the grid) falls
+    // inside it, keeping every occupied level in range and roughly
+    // centring `price` when there is room. False, book untouched, when
+    // no such band exists. O(ticks); meant for a drifting market, not
+    // for every order. A SPARSE book only moves while it is empty; its
+    // band is wide enough that it rarely needs to.
+    bool recenter(int64_t price);
+
+    // Level handle at idx (0 = none). The backend branch is the same for
+    // every call on a book, so it predicts perfectly.
+    inline uint32_t handle(uint8_t side, int32_t idx) const {
+        if (backend == LevelBackend::SPARSE) return trie.get(side, idx);
+        return (side == BUY) ? buy_levels[idx] : sell_levels[idx];
+    }
+
+    inline PriceLevel* level(uint8_t side, int32_t idx) {
+        uint32_t h = handle(side, idx);
+        return h ? &level_pool[h] : nullptr;
+    }
+
+    inline const PriceLevel* level(uint8_t side, int32_t idx) const {
+        uint32_t h = handle(side, idx);
+        return h ? &level_pool[h] : nullptr;
+    }
+
+    inline PriceLevel* best_level(uint8_t side) {
+        uint32_t h = (side == BUY) ? best_bid_level : best_ask_level;
+        return h ? &level_pool[h] : nullptr;
+    }
+
+    // Occupied index >= idx / <= idx on `side`, or -1
+    inline int32_t next_level(uint8_t side, int32_t idx) const {
+        if (backend == LevelBackend::SPARSE) return trie.find_next(side, idx);
+        return ((side == BUY) ? buy_bits : sell_bits).find_next(idx);
+    }
+
+    inline int32_t prev_level(uint8_t side, int32_t idx) const {
+        if (backend == LevelBackend::SPARSE) return trie.find_prev(side, idx);
+        return ((side == BUY) ? buy_bits : sell_bits).find_prev(idx);
+    }
+
+    // Whether an order can rest at idx without exhausting the level pool
+    // or the trie's node pool. Always true on a DENSE book.
+    inline bool can_rest(uint8_t side, int32_t idx) const {
+        if (handle(side, idx)) return true;
+        if (!level_free_head && level_pool_top >= LEVEL_POOL_SIZE)
+            return false;
+        return backend == LevelBackend::DENSE || trie.can_insert(side, idx);
+    }
+
+    // `pool`, when set, counts level allocations and frees (perf.h); the
+    // book is shared state, so the counters live with its one writer
+    PriceLevel* ensure_level(uint8_t side, int32_t idx,
+                             LevelPoolCounters* pool = nullptr);
+    void add_order(uint8_t side, int32_t idx, uint32_t oid,
+                   Orders& orders, LevelPoolCounters* pool = nullptr);
+
+    // O(1) unlink; releases the level and moves best when it empties.
+    void remove_order(uint8_t side, int32_t idx, uint32_t oid,
+                      Orders& orders, LevelPoolCounters* pool = nullptr);
+
+    // Up to `n` occupied levels on `side`, best first, into `out`; returns
+    // how many. One index step per level, so O(n) however wide the gaps.
+    size_t top_levels(uint8_t side, DepthLevel* out, size_t n) const;
 
-    void update_best_on_insert(uint8_t side, int32_t idx);
+    void update_best_on_insert(uint8_t side, int32_t idx, uint32_t h);
     void update_best_on_level_empty(uint8_t side, int32_t idx);
 
     // ✅ MUST be here
@@ -2,45 +2,104 @@
 #include <cassert>
 
 void Orders::init() {
-    next_order_id = 1;
+    slot_top = 1;
+    free_head = 0;
 }
 
-uint64_t Orders::create(uint64_t acct,
+// A reused slot keeps its low bits and moves to the next generation
+uint32_t Orders::create(uint32_t acct,
                         OrderSide s,
                         int64_t p,
-                        int64_t q) {
-    uint64_t oid = next_order_id++;
+                        int64_t q,
+                        uint64_t seq) {
+    assert(!full());
 
-    assert(oid < MAX_ORDERS);
+    uint32_t oid;
+    if (free_head) {
+        oid = free_head;
+        free_head = hot[oid].next;
+        cold[oid].id += ORDER_GENERATION;
+    } else {
+        oid = slot_top++;
+        cold[oid].id = oid;
+    }
+
+    OrderHot& h = hot[oid];
+    h.qty_remaining = q;
+    h.account = acct;
+    h.prev = 0;
+    h.next = 0;
+    h.acct_prev = 0;
+    h.acct_next = 0;
+    h.side = s;
+    h.state = OrderState::LIVE;
 
-    id[oid] = oid;
-    account_id[oid] = acct;
-    side[oid] = s;
-    price[oid] = p;
-    qty_remaining[oid] = q;
-    state[oid] = OrderState::LIVE;
+    cold[oid].price = p;
+    cold[oid].accepted_seq = seq;
+    cold[oid].quote_reserved = 0;
 
     return oid;
 }
 
-void Orders::cancel(uint64_t oid) {
-    assert(oid < next_order_id);
+void Orders::cancel(uint32_t oid) {
+    assert(oid < slot_top);
 
-    if (state[oid] == OrderState::LIVE) {
-        state[oid] = OrderState::CANCELLED;
+    if (hot[oid].state == OrderState::LIVE) {
+        hot[oid].state = OrderState::CANCELLED;
     }
 }
 
+void Orders::release(uint32_t oid) {
+    assert(oid && oid < slot_top && hot[oid].state != OrderState::LIVE);
+
+    hot[oid].next = free_head;
+    free_head = oid;
+}
+
+void Orders::account_append(uint32_t oid, uint32_t& head, uint32_t& tail) {
+    hot[oid].acct_prev = tail;
+    hot[oid].acct_next = 0;
+
+    if (tail) hot[tail].acct_next = oid;
+    else      head = oid;
+    tail = oid;
+}
+
+void Orders::account_unlink(uint32_t oid, uint32_t& head, uint32_t& tail) {
+    uint32_t p = hot[oid].acct_prev;
+    uint32_t n = hot[oid].acct_next;
+
+    if (p) hot[p].acct_next = n;
+    else   head = n;
+    if (n) hot[n].acct_prev = p;
+    else   tail = p;
+
+    hot[oid].acct_prev = 0;
+    hot[oid].acct_next = 0;
+}
+
 bool Orders::logical_equals(const Orders& o) const {
-    if (next_order_id != o.next_order_id)
+    if (slot_top != o.slot_top || free_head != o.free_head)
         return false;
 
-    for (uint64_t i = 1; i < next_order_id; ++i) {
-        if (account_id[i]    != o.account_id[i])    return false;
-        if (price[i]         != o.price[i])         return false;
-        if (qty_remaining[i] != o.qty_remaining[i]) return false;
-        if (side[i]          != o.side[i])          return false;
-        if (state[i]         != o.state[i])         return false;
+    for (uint32_t i = 1; i < slot_top; ++i) {
+        const OrderHot& a = hot[i];
+        const OrderHot& b = o.hot[i];
+        if (a.qty_remaining != b.qty_remaining) return false;
+        if (a.account       != b.account)       return false;
+        if (a.prev          != b.prev)          return false;
+        if (a.next          != b.next)          return false;
+        if (a.acct_prev     != b.acct_prev)     return false;
+        if (a.acct_next     != b.acct_next)     return false;
+        if (a.side          != b.side)          return false;
+        if (a.state         != b.state)         return false;
+
+        const OrderCold& x = cold[i];
+        const OrderCold& y = o.cold[i];
+        if (x.id             != y.id)             return false;
+        if (x.price          != y.price)          return false;
+        if (x.accepted_seq   != y.accepted_seq)   return false;
+        if (x.quote_reserved != y.quote_reserved) return false;
     }
     return true;
-}
\ No newline at end of file
+}
@@ -1,8 +1,20 @@
 #pragma once
 #include <cstdint>
+#include "accounts.h"   // Balance
 
 constexpr uint32_t MAX_ORDERS = 2'000'000;
 
+// Order ids: the low ORDER_SLOT_BITS are the row (slot) the order lives
+// in, the bits above a generation bumped each time the slot is reused.
+// Rows are recycled once an order fills or is cancelled, so the table
+// stays MAX_ORDERS deep however many orders the engine has seen, and an
+// id that outlived its order no longer matches the row's id.
+constexpr uint32_t ORDER_SLOT_BITS = 21;
+constexpr uint64_t ORDER_SLOT_MASK = (1ull << ORDER_SLOT_BITS) - 1;
+constexpr uint64_t ORDER_GENERATION = 1ull << ORDER_SLOT_BITS;
+
+static_assert(MAX_ORDERS - 1 <= ORDER_SLOT_MASK, "order slot bits");
+
 enum class OrderSide : uint8_t {
     BUY  = 0,
     SELL = 1
@@ -14,23 +26,77 @@ enum class OrderState : uint8_t {
     FILLED
 };
 
+// Everything the match loop reads or writes on a maker, packed so a fill
+// costs one line per maker instead of one per field array. Aligned to
+// half a line: two rows per line, none straddling a line boundary.
+struct alignas(32) OrderHot {
+    int64_t    qty_remaining;
+    uint32_t   account;       // Accounts slot
+
+    // Intrusive per-level FIFO links (0 = none); `next` also chains the
+    // free slots
+    uint32_t   prev;
+    uint32_t   next;
+
+    // Intrusive per-account list of resting orders, oldest first (0 =
+    // none); head and tail live in the account's AccountCold row
+    uint32_t   acct_prev;
+    uint32_t   acct_next;
+
+    OrderSide  side;
+    OrderState state;
+};
+
+static_assert(sizeof(OrderHot) == 32, "OrderHot is half a cache line");
+
+// Identity and as-submitted terms: cancels, reports and snapshots
+struct OrderCold {
+    uint64_t id;              // current order id of the slot
+    int64_t  price;
+    uint64_t accepted_seq;    // engine sequence that accepted the order
+
+    // What a resting BUY still holds of its account's quote_locked
+    // (0 for SELLs). Maker fills and cancel release from it alone, so
+    // the pieces add up to what was locked whatever the fee rounding.
+    Balance  quote_reserved;
+};
+
+// Indexed by slot (`oid` throughout); 0 = none
 struct Orders {
-    uint64_t  id[MAX_ORDERS];
-    uint64_t  account_id[MAX_ORDERS];
-    int64_t   price[MAX_ORDERS];
-    int64_t   qty_remaining[MAX_ORDERS];
-    OrderSide side[MAX_ORDERS];
-    OrderState state[MAX_ORDERS];
+    OrderHot  hot[MAX_ORDERS];
+    OrderCold cold[MAX_ORDERS];
 
-    uint64_t next_order_id;
+    uint32_t slot_top;     // slots [1, slot_top) have been handed out
+    uint32_t free_head;    // most recently released slot, LIFO
 
     void init();
-    uint64_t create(uint64_t account_id,
+
+    // Every slot holds a LIVE order
+    bool full() const { return free_head == 0 && slot_top >= MAX_ORDERS; }
+
+    // Returns the slot; the caller checks full() first
+    uint32_t create(uint32_t account_slot,
                     OrderSide side,
                     int64_t price,
-                    int64_t quantity);
+                    int64_t quantity,
+                    uint64_t sequence);
 
-    void cancel(uint64_t order_id);
+    void cancel(uint32_t oid);
+
+    // Back on the free list once FILLED / CANCELLED and out of the book
+    void release(uint32_t oid);
+
+    // Slot of the LIVE order `order_id`, 0 when unknown, done or stale
+    inline uint32_t find(uint64_t order_id) const {
+        uint32_t oid = static_cast<uint32_t>(order_id & ORDER_SLOT_MASK);
+        if (oid == 0 || oid >= slot_top || cold[oid].id != order_id ||
+            hot[oid].state != OrderState::LIVE)
+            return 0;
+        return oid;
+    }
+
+    // O(1) on the list headed by `head` / `tail`
+    void account_append(uint32_t oid, uint32_t& head, uint32_t& tail);
+    void account_unlink(uint32_t oid, uint32_t& head, uint32_t& tail);
     bool logical_equals(const Orders& o) const;
 };
-
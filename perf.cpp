@@ -1,3 +1,23 @@
 #include "perf.h"
 
-PerfRing g_perf;
\ No newline at end of file
+void PerfRing::merge(const PerfRing& other) {
+    // Pool counters are per book; the high water is the largest book's
+    level_pool.allocs += other.level_pool.allocs;
+    level_pool.reused += other.level_pool.reused;
+    level_pool.frees  += other.level_pool.frees;
+    if (other.level_pool.high_water > level_pool.high_water)
+        level_pool.high_water = other.level_pool.high_water;
+    band_recenters += other.band_recenters;
+
+    uint32_t n = other.head < PERF_BUFFER_SIZE ? other.head
+                                               : PERF_BUFFER_SIZE;
+    uint32_t first = other.head - n;
+
+    // Samples `other` already overwrote still count; the n appended
+    // below then fill the whole ring, so nothing stale survives the skip
+    head += first;
+    for (uint32_t i = 0; i < n; ++i) {
+        const PerfSample& s = other.samples[(first + i) % PERF_BUFFER_SIZE];
+        record(s.seq, s.start_tsc, s.end_tsc);
+    }
+}
@@ -7,15 +7,31 @@ struct PerfSample {
     uint64_t end_tsc;
 };
 
+// Price level pool activity (OrderBook::ensure_level / remove_order)
+struct LevelPoolCounters {
+    uint64_t allocs     = 0;   // levels handed out
+    uint64_t reused     = 0;   // ... of which came off the free list
+    uint64_t frees      = 0;   // levels returned on empty
+    uint32_t high_water = 0;   // highest pool slot ever handed out
+};
+
 constexpr uint32_t PERF_BUFFER_SIZE = 1'000'000;
 
+// Written by one matching thread only: each engine (or shard) records into
+// its own ring, and readers merge them once those threads have joined.
 struct PerfRing {
     PerfSample samples[PERF_BUFFER_SIZE];
     uint32_t   head = 0;
 
+    LevelPoolCounters level_pool;
+    uint64_t          band_recenters = 0;   // OrderBook::recenter shifts
+
     inline void record(uint64_t seq,
                        uint64_t start,
                        uint64_t end) {
         samples[head++ % PERF_BUFFER_SIZE] = {seq, start, end};
     }
-};
\ No newline at end of file
+
+    // Add `other`'s counters and append its samples, oldest first
+    void merge(const PerfRing& other);
+};
@@ -0,0 +1,431 @@
+#include "pipeline.h"
+#include "engine_common.h"
+
+#include <chrono>
+#include <cstdlib>   // calloc, free
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+static void die(const char*) {
+    ENGINE_ABORT("reason");
+}
+
+static inline uint64_t now_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void pin_to_core(uint32_t core) {
+#if defined(__linux__)
+    unsigned cores = std::thread::hardware_concurrency();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cores ? core % cores : 0, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+// Spin briefly, then give the core up (oversubscribed hosts)
+static inline void idle_wait(uint32_t& idle) {
+    if (++idle < 64) cpu_relax();
+    else std::this_thread::yield();
+}
+
+template <typename T, uint32_t Cap>
+static inline void push_wait(SpscRing<T, Cap>& ring, const T& v) {
+    while (!ring.try_push(v)) {
+        uint64_t t = ring.tail();
+        if (ring.try_push(v)) return;
+        ring.wait_for_space(t);
+    }
+}
+
+// =======================
+// Latency Histogram
+// =======================
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (total == 0) return 0;
+    if (p >= 1.0) return max;
+
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < LATENCY_BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen > rank) {
+            uint64_t c = bucket_ceiling(b);
+            return c < max ? c : max;
+        }
+    }
+    return max;
+}
+
+// =======================
+// Setup / Teardown
+// =======================
+
+struct Pipeline::Rings {
+    SpscRing<PipelineEntry, PIPELINE_RING_SIZE>   ingress;   // producer -> input
+    SpscRing<PipelineEntry, PIPELINE_RING_SIZE>   match;     // input -> matcher
+    SpscRing<PipelineEntry, PIPELINE_RING_SIZE>   journal;   // matcher -> output
+    SpscRing<ExecutionReport, PIPELINE_RING_SIZE> rejects;   // input -> output
+};
+
+Pipeline::Pipeline(EngineState& state, const PipelineConfig& cfg)
+    : state_(state), cfg_(cfg) {
+    rings_   = new Rings();
+    reports_ = new ExecutionRing(Backpressure::SPIN);
+    engine_  = new MatchingEngine(state_, reports_);
+
+    if (cfg_.journal)
+        journal_ = new JournalWriter(cfg_.journal_cfg);
+
+    next_seq_ = state_.last_sequence + 1;
+    last_grc_ = state_.last_grc_sequence;
+    journaled_seq_ = state_.last_sequence;
+    durable_seq_ = state_.last_sequence;
+
+    // Journaled but unsynced events stay under commit_every, plus the
+    // batch being appended and the matcher's one-batch lead. Commits by
+    // time alone have no such bound: take the largest window.
+    uint64_t window = PIPELINE_INFLIGHT_MIN;
+    if (cfg_.journal) {
+        uint64_t every = cfg_.journal_cfg.commit_every;
+        window = every ? every + PIPELINE_INFLIGHT_MIN : PIPELINE_INFLIGHT_MAX;
+        if (window > PIPELINE_INFLIGHT_MAX) window = PIPELINE_INFLIGHT_MAX;
+    }
+    inflight_ = uint64_t{1} << (64 - __builtin_clzll(window - 1));
+    if (inflight_ < PIPELINE_INFLIGHT_MIN) die("ingress window");
+
+    ingress_of_ = static_cast<uint64_t*>(
+        std::calloc(inflight_, sizeof(uint64_t)));
+    if (!ingress_of_) die("calloc");
+
+    frozen_ = static_cast<AccountIndexEntry*>(
+        std::calloc(ACCOUNT_INDEX_SIZE, sizeof(AccountIndexEntry)));
+    if (!frozen_) die("calloc");
+
+    const Accounts& accts = state_.accounts;
+    for (uint32_t slot = 1; slot < accts.live_end(); ++slot)
+        if (accts.hot[slot].state == AccountState::FROZEN)
+            freeze(accts.cold[slot].external_id);
+}
+
+Pipeline::~Pipeline() {
+    stop();
+
+    delete journal_;
+    delete engine_;
+    delete reports_;
+    delete rings_;
+    std::free(frozen_);
+    std::free(ingress_of_);
+}
+
+void Pipeline::start() {
+    if (running_.load()) return;
+
+    input_done_.store(false);
+    matcher_done_.store(false);
+    running_.store(true);
+
+    input_thread_   = std::thread([this] { run_input(); });
+    matcher_thread_ = std::thread([this] { run_matcher(); });
+    output_thread_  = std::thread([this] { run_output(); });
+}
+
+// Each stage exits once its upstream is done and its rings are empty
+void Pipeline::stop() {
+    if (!running_.load()) return;
+
+    running_.store(false, std::memory_order_release);
+    input_thread_.join();
+    matcher_thread_.join();
+    output_thread_.join();
+}
+
+PipelineStats Pipeline::stats() const {
+    PipelineStats s = stats_;
+    s.published = published_;
+    return s;
+}
+
+void Pipeline::submit(const EngineEvent& ev) {
+    push_wait(rings_->ingress, PipelineEntry{ev, now_ns()});
+}
+
+// =======================
+// Input Stage
+// =======================
+
+bool Pipeline::frozen(uint64_t account_id) const {
+    for (uint32_t i = account_index_hash(account_id);;
+         i = (i + 1) & (ACCOUNT_INDEX_SIZE - 1)) {
+        if (!frozen_[i].slot) return false;
+        if (frozen_[i].id == account_id) return true;
+    }
+}
+
+// Capped at MAX_ACCOUNTS ids, like the engine's own index, so the set
+// stays at most half full: past that the engine cannot open the account
+// either, and refuses its orders downstream all the same
+void Pipeline::freeze(uint64_t account_id) {
+    if (frozen_count_ >= MAX_ACCOUNTS) return;
+
+    uint32_t i = account_index_hash(account_id);
+    for (;; i = (i + 1) & (ACCOUNT_INDEX_SIZE - 1)) {
+        if (frozen_[i].id == account_id && frozen_[i].slot) return;
+        if (!frozen_[i].slot) break;
+    }
+    frozen_[i].id = account_id;
+    frozen_[i].slot = 1;
+    ++frozen_count_;
+}
+
+// False drops the event. Orders from frozen accounts are answered here
+// with the same reject the engine would send; the engine would change no
+// state for them, so dropping them leaves the book and ledger as if they
+// had been applied.
+bool Pipeline::admit(PipelineEntry& e) {
+    EngineEvent& ev = e.event;
+
+    uint64_t gw = ev.header.sequence;
+    if (gw <= last_gateway_seq_) {
+        ++stats_.duplicates;
+        return false;
+    }
+    if (gw != last_gateway_seq_ + 1) ++stats_.gaps;
+    last_gateway_seq_ = gw;
+
+    uint64_t account = 0;
+    uint8_t  side = 0;
+    int64_t  price = 0;
+    int64_t  quantity = 0;
+
+    switch (ev.header.type) {
+        case EventType::NEW_ORDER:
+            account  = ev.new_order.account_id;
+            side     = ev.new_order.side;
+            price    = ev.new_order.price;
+            quantity = ev.new_order.quantity;
+            break;
+
+        case EventType::MARKET_ORDER:
+            account  = ev.market.account_id;
+            side     = ev.market.side;
+            quantity = ev.market.quantity;
+            break;
+
+        // The engine aborts on a stale GRC sequence; refuse it here
+        case EventType::RISK_CONTROL:
+            if (ev.risk.grc_sequence <= last_grc_) {
+                ++stats_.stale_grc;
+                return false;
+            }
+            last_grc_ = ev.risk.grc_sequence;
+            if (ev.risk.command == RiskCommand::ACCOUNT_FREEZE)
+                freeze(ev.risk.account_id);
+            ev.header.sequence = next_seq_++;
+            return true;
+
+        case EventType::CANCEL:
+        case EventType::TIME_PULSE:
+            ev.header.sequence = next_seq_++;
+            return true;
+
+        default:
+            ++stats_.malformed;
+            return false;
+    }
+
+    if (frozen(account)) {
+        ++stats_.frozen;
+
+        ExecutionReport r{};
+        r.type       = ExecType::REJECTED;
+        r.side       = side;
+        r.reason     = RejectReason::ACCOUNT_FROZEN;
+        r.account_id = account;
+        r.price      = price;
+        r.quantity   = quantity;
+        push_wait(rings_->rejects, r);
+        return false;
+    }
+
+    ev.header.sequence = next_seq_++;
+    return true;
+}
+
+void Pipeline::run_input() {
+    if (cfg_.pin_cores) pin_to_core(cfg_.first_core);
+
+    PipelineEntry batch[PIPELINE_BATCH];
+    uint32_t idle = 0;
+
+    for (;;) {
+        size_t n = rings_->ingress.pop_batch(batch, PIPELINE_BATCH);
+
+        if (n == 0) {
+            if (!running_.load(std::memory_order_acquire) &&
+                rings_->ingress.empty())
+                break;
+            idle_wait(idle);
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            if (!admit(batch[i])) continue;
+            ++stats_.accepted;
+            push_wait(rings_->match, batch[i]);
+        }
+    }
+
+    input_done_.store(true, std::memory_order_release);
+}
+
+// =======================
+// Matcher Stage
+// =======================
+
+// The batch goes to the journal ring before it is applied, so every
+// report the engine emits belongs to an event the output stage has
+// already been handed: it never waits on the matcher to publish, and the
+// matcher's SPIN backpressure on a full report ring cannot deadlock.
+void Pipeline::run_matcher() {
+    if (cfg_.pin_cores) pin_to_core(cfg_.first_core + 1);
+
+    PipelineEntry batch[PIPELINE_BATCH];
+    EngineEvent   events[PIPELINE_BATCH];
+    uint32_t idle = 0;
+
+    for (;;) {
+        size_t n = rings_->match.pop_batch(batch, PIPELINE_BATCH);
+
+        if (n == 0) {
+            if (input_done_.load(std::memory_order_acquire) &&
+                rings_->match.empty())
+                break;
+            idle_wait(idle);
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            push_wait(rings_->journal, batch[i]);
+            events[i] = batch[i].event;
+        }
+
+        engine_->apply_batch(events, n);
+    }
+
+    matcher_done_.store(true, std::memory_order_release);
+}
+
+// =======================
+// Output Stage
+// =======================
+
+void Pipeline::journal_batch(const PipelineEntry* batch, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const EngineEvent& ev = batch[i].event;
+        if (journal_) journal_->append(ev);
+        ingress_of_[ev.header.sequence & (inflight_ - 1)] =
+            batch[i].ingress_ns;
+    }
+    journaled_seq_ = batch[n - 1].event.header.sequence;
+
+    // The journal commits on its own thresholds as it appends
+    durable_seq_ = journal_ ? journal_->synced_sequence() : journaled_seq_;
+}
+
+// Reports wait for their event to be durable. While events keep coming
+// the journal's group commit releases them; once the flow pauses, what is
+// pending is committed here rather than held back.
+void Pipeline::sync_journal() {
+    journal_->commit();
+    durable_seq_ = journal_->synced_sequence();
+}
+
+// Publish reports up to the first one whose event is not durable yet;
+// true if anything went out
+bool Pipeline::publish_ready() {
+    bool any = false;
+
+    for (;;) {
+        if (carry_pos_ == carry_len_) {
+            carry_len_ = reports_->ring.pop_batch(carry_, EXEC_PUBLISH_BATCH);
+            carry_pos_ = 0;
+            if (carry_len_ == 0) return any;
+        }
+
+        size_t end = carry_pos_;
+        while (end < carry_len_ && carry_[end].sequence <= durable_seq_)
+            ++end;
+        if (end == carry_pos_) return any;
+
+        uint64_t now = now_ns();
+        for (size_t i = carry_pos_; i < end; ++i) {
+            if (carry_[i].type != ExecType::TRADE) continue;
+            uint64_t t0 =
+                ingress_of_[carry_[i].sequence & (inflight_ - 1)];
+            latency_.record(now - t0);
+        }
+
+        if (cfg_.handler)
+            cfg_.handler(carry_ + carry_pos_, end - carry_pos_, cfg_.ctx);
+        published_ += end - carry_pos_;
+        carry_pos_ = end;
+        any = true;
+    }
+}
+
+void Pipeline::run_output() {
+    if (cfg_.pin_cores) pin_to_core(cfg_.first_core + 2);
+
+    PipelineEntry   batch[PIPELINE_BATCH];
+    ExecutionReport rejects[EXEC_PUBLISH_BATCH];
+    uint32_t idle = 0;
+
+    for (;;) {
+        // Read before draining: anything pushed ahead of the flag is seen
+        bool upstream_done = matcher_done_.load(std::memory_order_acquire);
+
+        size_t n = rings_->journal.pop_batch(batch, PIPELINE_BATCH);
+        if (n) {
+            // Reports still waiting hold stamps back to durable_seq_ (or
+            // the matcher's lead): sync and publish them before this
+            // batch's stamps would wrap onto theirs
+            uint64_t last = batch[n - 1].event.header.sequence;
+            if (last - durable_seq_ > inflight_ - 2 * PIPELINE_BATCH) {
+                sync_journal();
+                publish_ready();
+            }
+            journal_batch(batch, n);
+        } else if (durable_seq_ < journaled_seq_) {
+            sync_journal();
+        }
+
+        bool sent = publish_ready();
+
+        size_t r = rings_->rejects.pop_batch(rejects, EXEC_PUBLISH_BATCH);
+        if (r) {
+            if (cfg_.handler) cfg_.handler(rejects, r, cfg_.ctx);
+            published_ += r;
+        }
+
+        if (n || sent || r) {
+            idle = 0;
+            continue;
+        }
+        if (upstream_done) break;
+        idle_wait(idle);
+    }
+
+    if (journal_) journal_->commit();
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include "engine.h"
+#include "journal.h"
+
+#include <atomic>
+#include <thread>
+
+// =======================
+// Latency Histogram
+// =======================
+//
+// Log-linear buckets: one row per power of two, each split into
+// LATENCY_SUB_BUCKETS equal steps, so every recorded value is kept to
+// within ~6% of its true size. Fixed size, no allocation on record().
+
+constexpr uint32_t LATENCY_SUB_BITS    = 4;
+constexpr uint32_t LATENCY_SUB_BUCKETS = 1u << LATENCY_SUB_BITS;
+constexpr uint32_t LATENCY_BUCKETS     = 64 * LATENCY_SUB_BUCKETS;
+
+struct LatencyHistogram {
+    uint64_t counts[LATENCY_BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    static inline uint32_t bucket_of(uint64_t v) {
+        if (v < LATENCY_SUB_BUCKETS) return static_cast<uint32_t>(v);
+        uint32_t top = 63u - static_cast<uint32_t>(__builtin_clzll(v));
+        uint32_t sub = static_cast<uint32_t>(
+            (v >> (top - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+        return (top - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+    }
+
+    // Largest value that lands in bucket b
+    static inline uint64_t bucket_ceiling(uint32_t b) {
+        if (b < LATENCY_SUB_BUCKETS) return b;
+        uint32_t top = b / LATENCY_SUB_BUCKETS + LATENCY_SUB_BITS - 1;
+        uint64_t sub = b % LATENCY_SUB_BUCKETS;
+        uint64_t step = 1ull << (top - LATENCY_SUB_BITS);
+        return (1ull << top) + (sub + 1) * step - 1;
+    }
+
+    inline void record(uint64_t v) {
+        ++counts[bucket_of(v)];
+        ++total;
+        sum += v;
+        if (v > max) max = v;
+    }
+
+    // Upper bound of the bucket holding the p-th fraction (0..1) of
+    // recorded values; exact for the maximum
+    uint64_t percentile(double p) const;
+};
+
+// =======================
+// Pipeline
+// =======================
+//
+// Three threads, each optionally pinned to its own core, joined by SPSC
+// rings:
+//
+//   submit() -> [input] -> [matcher] -> [output]
+//
+//   input    gateway sequence check, event validation and a frozen-account
+//            pre-filter; survivors are stamped with contiguous engine
+//            sequences
+//   matcher  forwards each batch to the output stage's journal ring, then
+//            runs it through MatchingEngine::apply_batch
+//   output   appends events to the journal and publishes execution reports
+//            once the event that produced them is synced to it (handed to
+//            the output stage, without a journal)
+//
+// Every event is stamped with its ingress time on submit(); the output
+// stage records ingress -> publication latency for each TRADE report.
+
+constexpr uint32_t PIPELINE_RING_SIZE = 1u << 14;
+constexpr size_t   PIPELINE_BATCH     = 256;
+
+// Ingress stamps of journaled events whose reports may still be pending,
+// indexed by sequence. Reports wait for the journal's group commit, so
+// the window is sized from commit_every plus a few batches for the
+// matcher's lead; when time-based commits let the unsynced span grow
+// past it, the output stage commits and publishes before journaling
+// more, so a stamp is never overwritten while its reports wait.
+constexpr uint32_t PIPELINE_INFLIGHT_MIN = 4 * PIPELINE_BATCH;
+constexpr uint32_t PIPELINE_INFLIGHT_MAX = 1u << 20;
+
+struct PipelineEntry {
+    EngineEvent event;
+    uint64_t    ingress_ns;
+};
+
+struct PipelineConfig {
+    bool     pin_cores  = true;
+    uint32_t first_core = 0;       // input; matcher and output follow
+
+    bool          journal = false;
+    JournalConfig journal_cfg;
+
+    // Called on the output thread with published reports, pre-filter
+    // rejects included (those carry sequence 0: they never reached the
+    // engine)
+    ExecutionHandler handler = nullptr;
+    void*            ctx     = nullptr;
+};
+
+struct PipelineStats {
+    uint64_t accepted;        // forwarded to the matcher
+    uint64_t duplicates;      // gateway sequence not above the last seen
+    uint64_t gaps;            // gateway sequence skipped ahead
+    uint64_t malformed;       // unknown event type
+    uint64_t stale_grc;       // risk command replayed or out of order
+    uint64_t frozen;          // orders refused by the pre-filter
+    uint64_t published;       // reports handed to the handler
+};
+
+class Pipeline {
+public:
+    // Takes over `state` until destruction: the matcher thread is its only
+    // writer while running. Accounts already frozen in `state` seed the
+    // pre-filter.
+    Pipeline(EngineState& state, const PipelineConfig& cfg);
+    ~Pipeline();
+
+    void start();
+
+    // Producer thread only. `ev.header.sequence` is the gateway sequence.
+    void submit(const EngineEvent& ev);
+
+    // Drain every stage, then join the threads.
+    void stop();
+
+    // Output thread (the report handler) only: the highest sequence whose
+    // event is durable, and so whose reports may be published
+    uint64_t durable_sequence() const { return durable_seq_; }
+
+    // Not synchronised with running stages: read after stop()
+    const LatencyHistogram& latency() const { return latency_; }
+    PipelineStats stats() const;
+
+private:
+    struct Rings;
+
+    void run_input();
+    void run_matcher();
+    void run_output();
+
+    bool admit(PipelineEntry& e);
+    bool frozen(uint64_t account_id) const;
+    void freeze(uint64_t account_id);
+
+    void journal_batch(const PipelineEntry* batch, size_t n);
+    void sync_journal();
+    bool publish_ready();
+
+    EngineState&   state_;
+    PipelineConfig cfg_;
+
+    Rings*          rings_ = nullptr;
+    ExecutionRing*  reports_ = nullptr;
+    MatchingEngine* engine_ = nullptr;
+    JournalWriter*  journal_ = nullptr;
+
+    std::thread input_thread_;
+    std::thread matcher_thread_;
+    std::thread output_thread_;
+
+    alignas(CACHE_LINE) std::atomic<bool> running_{false};
+    std::atomic<bool> input_done_{false};
+    std::atomic<bool> matcher_done_{false};
+
+    // ---- input stage ----
+    alignas(CACHE_LINE) uint64_t last_gateway_seq_ = 0;
+    uint64_t next_seq_ = 0;
+    uint64_t last_grc_ = 0;
+    PipelineStats stats_ = {};
+
+    // Open-addressed set of frozen account ids, same hash as the
+    // engine's account index. Freezes are never lifted, so the set only
+    // grows and stays exact.
+    AccountIndexEntry* frozen_ = nullptr;
+    uint32_t frozen_count_ = 0;
+
+    // ---- output stage ----
+    alignas(CACHE_LINE) uint64_t journaled_seq_ = 0;
+    uint64_t durable_seq_ = 0;     // reports up to here may go out
+    uint64_t published_ = 0;
+    uint64_t* ingress_of_ = nullptr;   // [inflight_]
+    uint64_t  inflight_ = 0;           // power of two
+
+    ExecutionReport carry_[EXEC_PUBLISH_BATCH];
+    size_t carry_pos_ = 0;
+    size_t carry_len_ = 0;
+
+    LatencyHistogram latency_;
+};
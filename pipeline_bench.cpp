@@ -0,0 +1,321 @@
+#include "pipeline.h"
+#include "instruments.h"
+#include "invariants.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// ------------------------------------------------------------
+// Input -> matcher -> output pipeline, journaling on:
+//   1. saturated: the producer submits as fast as the rings take it
+//   2. paced: one event every PACE_NS, latency without queueing
+//   3. wide commit: group commits far apart, latency checked per trade
+// Ingress -> trade publication percentiles for each, then the final
+// state is checked against the same stream applied directly and against
+// a replay of the journal.
+// ------------------------------------------------------------
+
+constexpr uint64_t ACCOUNTS = 1000;
+constexpr uint64_t EVENTS = 1'000'000;
+constexpr uint64_t PACED_EVENTS = 100'000;
+constexpr uint64_t PACE_NS = 5'000;
+
+constexpr __int128 BASE_FUNDS  = 1'000'000'000;
+constexpr __int128 QUOTE_FUNDS = 1'000'000'000'000;
+
+constexpr const char* BENCH_DIR = "pipeline_journal.d";
+
+static EngineState* funded_state() {
+    auto* st = static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    if (!st) std::abort();
+    init_instrument(*st, DEFAULT_INSTRUMENT);
+    for (uint64_t a = 0; a < ACCOUNTS; ++a) {
+        uint32_t slot = st->accounts.open(a);
+        st->accounts.hot[slot].base_available  = BASE_FUNDS;
+        st->accounts.hot[slot].quote_available = QUOTE_FUNDS;
+    }
+    return st;
+}
+
+// Crossing flow with a freeze every 100k events (later orders from that
+// account are refused by the pre-filter) and a replayed gateway
+// sequence every 50k (dropped as a duplicate)
+static std::vector<EngineEvent> make_flow(uint64_t count) {
+    std::vector<EngineEvent> flow;
+    flow.reserve(count + count / 50'000);
+    uint64_t grc = 0;
+
+    for (uint64_t i = 1; i <= count; ++i) {
+        EngineEvent ev{};
+        ev.header.sequence = i;
+
+        if (i % 100'000 == 0) {
+            ev.header.type = EventType::RISK_CONTROL;
+            ev.risk.grc_sequence = ++grc;
+            ev.risk.command = RiskCommand::ACCOUNT_FREEZE;
+            ev.risk.account_id = (i / 100'000) % ACCOUNTS;
+        } else {
+            ev.header.type = EventType::NEW_ORDER;
+            ev.new_order.account_id = i % ACCOUNTS;
+            ev.new_order.side       = static_cast<uint8_t>((i / 3) & 1);
+            ev.new_order.price      = DEFAULT_INSTRUMENT.min_price +
+                                      static_cast<int64_t>(i % 64);
+            ev.new_order.quantity   = 1;
+        }
+        flow.push_back(ev);
+
+        if (i % 50'000 == 0) flow.push_back(ev);
+    }
+    return flow;
+}
+
+struct TradeCount {
+    const Pipeline* pipe = nullptr;
+    uint64_t        trades = 0;
+};
+
+// No report may go out before its event is synced to the journal
+static void count_trades(const ExecutionReport* batch, size_t n, void* ctx) {
+    auto* tally = static_cast<TradeCount*>(ctx);
+    for (size_t i = 0; i < n; ++i) {
+        if (batch[i].sequence > tally->pipe->durable_sequence()) {
+            std::fprintf(stderr, "report for %llu published before sync\n",
+                         static_cast<unsigned long long>(batch[i].sequence));
+            std::abort();
+        }
+        if (batch[i].type == ExecType::TRADE) ++tally->trades;
+    }
+}
+
+static void same_state(const EngineState& a, const EngineState& b,
+                       const char* what) {
+    if (!a.orders.logical_equals(b.orders) ||
+        !a.accounts.logical_equals(b.accounts) ||
+        !a.book.logical_equals(b.book)) {
+        std::fprintf(stderr, "pipeline state differs from %s\n", what);
+        std::abort();
+    }
+}
+
+static void print_latency(const LatencyHistogram& h) {
+    std::printf("  ingress -> trade publication (ns):"
+                " p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+                static_cast<unsigned long long>(h.percentile(0.50)),
+                static_cast<unsigned long long>(h.percentile(0.90)),
+                static_cast<unsigned long long>(h.percentile(0.99)),
+                static_cast<unsigned long long>(h.percentile(0.999)),
+                static_cast<unsigned long long>(h.max));
+}
+
+static void run(const char* name, uint64_t count, uint64_t pace_ns) {
+    journal_remove_segments(BENCH_DIR);
+
+    std::vector<EngineEvent> flow = make_flow(count);
+    EngineState* st = funded_state();
+    TradeCount tally;
+
+    PipelineConfig cfg;
+    cfg.journal = true;
+    cfg.journal_cfg.dir = BENCH_DIR;
+    cfg.journal_cfg.segment_records = 1u << 18;
+    cfg.handler = count_trades;
+    cfg.ctx = &tally;
+
+    PipelineStats stats;
+    double seconds;
+    {
+        Pipeline pipe(*st, cfg);
+        tally.pipe = &pipe;
+        pipe.start();
+
+        auto start = std::chrono::steady_clock::now();
+        auto next = start;
+        for (const EngineEvent& ev : flow) {
+            if (pace_ns) {
+                next += std::chrono::nanoseconds(pace_ns);
+                while (std::chrono::steady_clock::now() < next) cpu_relax();
+            }
+            pipe.submit(ev);
+        }
+        pipe.stop();
+        seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        stats = pipe.stats();
+        std::printf("[%s] %llu events in %.3f sec: %.0f events/sec\n", name,
+                    static_cast<unsigned long long>(flow.size()), seconds,
+                    static_cast<double>(flow.size()) / seconds);
+        std::printf("  accepted %llu, duplicates %llu, frozen %llu,"
+                    " trades %llu\n",
+                    static_cast<unsigned long long>(stats.accepted),
+                    static_cast<unsigned long long>(stats.duplicates),
+                    static_cast<unsigned long long>(stats.frozen),
+                    static_cast<unsigned long long>(tally.trades));
+        print_latency(pipe.latency());
+    }
+
+    InvariantChecker::check_book(*st);
+    InvariantChecker::check_balances(*st, BASE_FUNDS * ACCOUNTS,
+                                     QUOTE_FUNDS * ACCOUNTS);
+
+    // Direct apply, dropping what the pre-filter drops (duplicates and
+    // orders from frozen accounts) so engine sequences line up
+    EngineState* ref = funded_state();
+    {
+        MatchingEngine engine(*ref);
+        std::vector<bool> frozen(ACCOUNTS);
+        uint64_t gw = 0;
+        uint64_t seq = 0;
+        for (EngineEvent ev : flow) {
+            if (ev.header.sequence <= gw) continue;
+            gw = ev.header.sequence;
+
+            if (ev.header.type == EventType::RISK_CONTROL &&
+                ev.risk.command == RiskCommand::ACCOUNT_FREEZE)
+                frozen[ev.risk.account_id] = true;
+            if (ev.header.type == EventType::NEW_ORDER &&
+                frozen[ev.new_order.account_id])
+                continue;
+
+            ev.header.sequence = ++seq;
+            engine.apply(ev);
+        }
+    }
+    same_state(*st, *ref, "direct apply");
+
+    // Journal replay reproduces the pipeline's state exactly
+    EngineState* replayed = funded_state();
+    {
+        MatchingEngine engine(*replayed);
+        JournalReader reader(BENCH_DIR);
+        while (const EngineEvent* ev = reader.next())
+            engine.apply(*ev);
+        if (replayed->last_sequence != st->last_sequence) {
+            std::fprintf(stderr, "journal replay stopped at %llu of %llu\n",
+                         static_cast<unsigned long long>(replayed->last_sequence),
+                         static_cast<unsigned long long>(st->last_sequence));
+            std::abort();
+        }
+    }
+    same_state(*st, *replayed, "journal replay");
+
+    std::free(replayed);
+    std::free(ref);
+    std::free(st);
+}
+
+// ------------------------------------------------------------
+// Group commits wider than one stamp window's worth of the old fixed
+// ring: each TRADE's recorded latency must come from its own event's
+// ingress stamp. The producer keeps its own stamps, taken just before
+// submit(), and the handler times each trade after the pipeline has, so
+// every pipeline value is at most the matching one here and the two
+// distributions sit close together.
+// ------------------------------------------------------------
+// Stops before make_flow's first freeze
+constexpr uint64_t WIDE_EVENTS = 99'999;
+constexpr uint32_t WIDE_COMMIT = 1u << 15;
+constexpr uint64_t WIDE_PACE_NS = 5'000;   // spreads the ingress stamps
+constexpr uint64_t WIDE_STALL_MS = 100;
+constexpr uint64_t WIDE_MEAN_SLACK_NS = 2'000'000;
+
+struct WideCommit {
+    const uint64_t*  submitted = nullptr;   // by engine sequence
+    bool             stalled = false;
+    LatencyHistogram latency;
+};
+
+static void time_trades(const ExecutionReport* batch, size_t n, void* ctx) {
+    auto* w = static_cast<WideCommit*>(ctx);
+
+    // Stall the output stage once, so the journal ring backs up and is
+    // then drained in one run of batches with no pause to sync on
+    if (!w->stalled) {
+        w->stalled = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(WIDE_STALL_MS));
+    }
+    uint64_t now = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    for (size_t i = 0; i < n; ++i)
+        if (batch[i].type == ExecType::TRADE)
+            w->latency.record(now - w->submitted[batch[i].sequence]);
+}
+
+static void run_wide_commit() {
+    journal_remove_segments(BENCH_DIR);
+
+    // No freezes, and duplicates are skipped here, so engine sequence =
+    // gateway sequence
+    std::vector<EngineEvent> flow = make_flow(WIDE_EVENTS);
+    std::vector<uint64_t> submitted(WIDE_EVENTS + 1);
+    EngineState* st = funded_state();
+    WideCommit wide;
+    wide.submitted = submitted.data();
+
+    PipelineConfig cfg;
+    cfg.journal = true;
+    cfg.journal_cfg.dir = BENCH_DIR;
+    cfg.journal_cfg.segment_records = 1u << 18;
+    cfg.journal_cfg.commit_every = WIDE_COMMIT;
+    cfg.journal_cfg.commit_interval_ns = 0;
+    cfg.handler = time_trades;
+    cfg.ctx = &wide;
+
+    {
+        Pipeline pipe(*st, cfg);
+        pipe.start();
+        uint64_t seq = 0;
+        auto next = std::chrono::steady_clock::now();
+        for (const EngineEvent& ev : flow) {
+            if (ev.header.sequence <= seq) continue;   // duplicate
+            seq = ev.header.sequence;
+            next += std::chrono::nanoseconds(WIDE_PACE_NS);
+            while (std::chrono::steady_clock::now() < next) cpu_relax();
+            submitted[seq] = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+            pipe.submit(ev);
+        }
+        pipe.stop();
+
+        const LatencyHistogram& got = pipe.latency();
+        const LatencyHistogram& want = wide.latency;
+        std::printf("[wide commit, every %u events]\n", WIDE_COMMIT);
+        print_latency(got);
+
+        // The stalled batch alone puts want a little above got; a stamp
+        // taken from a later event puts got well below
+        uint64_t got_mean  = got.total ? got.sum / got.total : 0;
+        uint64_t want_mean = want.total ? want.sum / want.total : 0;
+        if (got.total != want.total || got.total == 0 ||
+            got.max > want.max || got_mean > want_mean ||
+            want_mean - got_mean > WIDE_MEAN_SLACK_NS) {
+            std::fprintf(stderr,
+                         "wide commit: %llu trades timed, mean %llu ns,"
+                         " expected %llu trades, mean %llu ns\n",
+                         static_cast<unsigned long long>(got.total),
+                         static_cast<unsigned long long>(got_mean),
+                         static_cast<unsigned long long>(want.total),
+                         static_cast<unsigned long long>(want_mean));
+            std::abort();
+        }
+    }
+    std::free(st);
+}
+
+int main() {
+    std::printf("hardware threads=%u\n", std::thread::hardware_concurrency());
+
+    run("saturated", EVENTS, 0);
+    run("paced", PACED_EVENTS, PACE_NS);
+    run_wide_commit();
+
+    journal_remove_segments(BENCH_DIR);
+    ::rmdir(BENCH_DIR);
+}
@@ -0,0 +1,222 @@
+#include "recovery.h"
+#include "engine.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "snapshot_lz4.h"
+#include "snapshot_delta.h"
+#include "engine_common.h"
+
+#include <algorithm>   // sort
+#include <chrono>
+#include <cstdio>      // snprintf
+#include <cstdlib>     // calloc, free
+#include <cstring>     // strlen, strcmp, strncpy
+#include <dirent.h>    // opendir, readdir
+#include <fcntl.h>     // open
+#include <unistd.h>    // read, close
+
+// Events per reader batch and prefetch distance (as in replay)
+constexpr size_t RECOVERY_BATCH = 256;
+constexpr size_t RECOVERY_PREFETCH = 8;
+
+static void die(const char*) {
+    ENGINE_ABORT("reason");
+}
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct SnapshotFile {
+    SnapshotKind kind;
+    uint64_t     sequence;        // state after applying this file
+    uint64_t     base_sequence;   // deltas only
+    char         path[320];
+};
+
+// =======================
+// Directory Scan
+// =======================
+
+static bool classify(const char* path, SnapshotFile& f) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    union {
+        uint32_t                 magic;
+        SnapshotHeader           raw;
+        CompressedSnapshotHeader lz4;
+        DeltaSnapshotHeader      delta;
+    } hdr{};
+
+    ssize_t n = ::read(fd, &hdr, sizeof(hdr));
+    ::close(fd);
+
+    if (n >= (ssize_t)sizeof(SnapshotHeader) && hdr.magic == SNAPSHOT_MAGIC) {
+        f.kind = SnapshotKind::RAW;
+        f.sequence = hdr.raw.last_sequence;
+    } else if (n >= (ssize_t)sizeof(CompressedSnapshotHeader) &&
+               hdr.magic == SNAPSHOT_MAGIC_LZ4) {
+        f.kind = SnapshotKind::LZ4;
+        f.sequence = hdr.lz4.last_sequence;
+    } else if (n >= (ssize_t)sizeof(DeltaSnapshotHeader) &&
+               hdr.magic == DELTA_SNAPSHOT_MAGIC) {
+        f.kind = SnapshotKind::DELTA;
+        f.sequence = hdr.delta.delta_sequence;
+        f.base_sequence = hdr.delta.base_sequence;
+    } else {
+        return false;
+    }
+
+    std::snprintf(f.path, sizeof(f.path), "%s", path);
+    return true;
+}
+
+static uint32_t scan_snapshots(const char* dir, SnapshotFile* out) {
+    if (!dir) return 0;
+
+    DIR* d = ::opendir(dir);
+    if (!d) return 0;
+
+    uint32_t count = 0;
+    while (dirent* e = ::readdir(d)) {
+        if (count == MAX_SNAPSHOT_FILES) break;
+        if (e->d_name[0] == '.') continue;
+
+        size_t len = std::strlen(e->d_name);
+        if (len >= 4 && std::strcmp(e->d_name + len - 4, ".tmp") == 0)
+            continue;   // interrupted write
+
+        char path[320];
+        std::snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+
+        SnapshotFile f{};
+        if (classify(path, f))
+            out[count++] = f;
+    }
+
+    ::closedir(d);
+
+    // Newest first
+    std::sort(out, out + count,
+              [](const SnapshotFile& a, const SnapshotFile& b) {
+                  return a.sequence > b.sequence;
+              });
+    return count;
+}
+
+// =======================
+// Journal Checks
+// =======================
+
+// True if the journal can carry a state at `sequence` forward: its first
+// event after `sequence` is sequence + 1, or there is none.
+static bool journal_continues(const char* dir, uint64_t sequence) {
+    JournalReader log(dir);
+    log.seek(sequence);
+
+    const EngineEvent* ev = log.next();
+    return !ev || ev->header.sequence == sequence + 1;
+}
+
+// =======================
+// Recovery
+// =======================
+
+void recover(const char* snapshot_dir,
+             const char* journal_dir,
+             EngineState& state,
+             RecoveryStats& stats) {
+    uint64_t t0 = now_ns();
+
+    auto* files = static_cast<SnapshotFile*>(
+        std::calloc(MAX_SNAPSHOT_FILES, sizeof(SnapshotFile)));
+    if (!files) die("calloc");
+
+    uint32_t count = scan_snapshots(snapshot_dir, files);
+
+    uint64_t t1 = now_ns();
+    stats.scan_ns = t1 - t0;
+
+    bool have_base = false;
+    bool touched = false;   // a rejected candidate left data behind
+
+    for (uint32_t i = 0; i < count && !have_base; ++i) {
+        const SnapshotFile& base = files[i];
+        if (base.kind == SnapshotKind::DELTA) continue;
+
+        // Snapshot readers fill in live data only
+        if (touched) zero_state(state);
+        touched = true;
+
+        uint64_t l0 = now_ns();
+        bool loaded = (base.kind == SnapshotKind::RAW)
+                          ? load_snapshot(base.path, state)
+                          : load_snapshot_lz4(base.path, state);
+        stats.load_ns += now_ns() - l0;
+
+        if (!loaded) {
+            ++stats.candidates_rejected;
+            continue;
+        }
+
+        // Chain deltas forward; list is newest first, so walk backwards
+        uint64_t d0 = now_ns();
+        uint32_t deltas = 0;
+        for (bool advanced = true; advanced;) {
+            advanced = false;
+            for (uint32_t k = count; k-- > 0;) {
+                const SnapshotFile& d = files[k];
+                if (d.kind != SnapshotKind::DELTA ||
+                    d.base_sequence != state.last_sequence)
+                    continue;
+
+                if (apply_delta_snapshot(d.path, state)) {
+                    ++deltas;
+                    advanced = true;
+                    break;
+                }
+            }
+        }
+        stats.delta_ns += now_ns() - d0;
+
+        if (!journal_continues(journal_dir, state.last_sequence)) {
+            ++stats.candidates_rejected;
+            continue;
+        }
+
+        have_base = true;
+        stats.base_kind = base.kind;
+        std::snprintf(stats.base_path, sizeof(stats.base_path), "%s",
+                      base.path);
+        stats.deltas_applied = deltas;
+    }
+
+    std::free(files);
+
+    if (!have_base && touched)
+        zero_state(state);
+
+    stats.snapshot_sequence = state.last_sequence;
+
+    // Journal tail
+    uint64_t r0 = now_ns();
+
+    MatchingEngine engine(state);
+    JournalReader log(journal_dir);
+    log.seek(state.last_sequence);
+
+    const EngineEvent* batch[RECOVERY_BATCH];
+    while (size_t n = log.next_batch(batch, RECOVERY_BATCH)) {
+        for (size_t i = 0; i < n; ++i) {
+            if (i + RECOVERY_PREFETCH < n)
+                engine.prefetch(*batch[i + RECOVERY_PREFETCH]);
+            engine.apply(*batch[i]);
+        }
+    }
+
+    stats.events_replayed = log.records_read();
+    stats.replay_ns = now_ns() - r0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "engine_state.h"
+#include <cstdint>
+
+// =======================
+// Recovery
+// =======================
+//
+// Restart = newest usable snapshot + the journal tail after it.
+//
+// Every file in the snapshot directory is classified by its header magic
+// (raw, LZ4 or delta; *.tmp and unknown files are ignored). Full snapshots
+// are tried newest first. Deltas are then chained on while one exists whose
+// base_sequence is the current state's last_sequence. A candidate is only
+// used if the journal continues exactly at last_sequence + 1 (or has
+// nothing after it). With no usable snapshot, recovery starts from an
+// empty state and replays the whole journal.
+
+enum class SnapshotKind : uint8_t {
+    NONE,
+    RAW,
+    LZ4,
+    DELTA
+};
+
+constexpr uint32_t MAX_SNAPSHOT_FILES = 1024;
+
+struct RecoveryStats {
+    SnapshotKind base_kind = SnapshotKind::NONE;
+    char         base_path[320] = {};
+
+    uint64_t snapshot_sequence = 0;   // after deltas
+    uint32_t deltas_applied = 0;
+    uint32_t candidates_rejected = 0;
+    uint64_t events_replayed = 0;
+
+    // Phase timings
+    uint64_t scan_ns = 0;
+    uint64_t load_ns = 0;
+    uint64_t delta_ns = 0;
+    uint64_t replay_ns = 0;
+};
+
+// Rebuild `state` from snapshot_dir (may be nullptr) and journal_dir.
+// `state` must be zeroed by the caller.
+void recover(const char* snapshot_dir,
+             const char* journal_dir,
+             EngineState& state,
+             RecoveryStats& stats);
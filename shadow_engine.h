@@ -1,13 +1,19 @@
 #pragma once
 #include "engine.h"
 
+// Replica fed the primary's stream. Compare digest() with the primary's
+// every N events; only on a mismatch walk the tables with
+// state_difference() to find what diverged.
 struct ShadowEngine {
     EngineState state;
+    StateDigest rolling;
     MatchingEngine engine;
 
-    ShadowEngine() : engine(state) {}
+    ShadowEngine() : engine(state, nullptr, nullptr, nullptr, &rolling) {}
 
     void apply(const EngineEvent& ev) {
         engine.apply(ev);
     }
-};
\ No newline at end of file
+
+    uint64_t digest() const { return rolling.value(state); }
+};
@@ -0,0 +1,190 @@
+#include "shard.h"
+#include "engine_common.h"
+
+#include <cstdlib>   // calloc, free
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+static void die(const char*) {
+    ENGINE_ABORT("reason");
+}
+
+struct ShardedEngine::Shard {
+    SpscRing<EngineEvent, SHARD_RING_SIZE> ring;
+    std::thread            thread;
+    std::atomic<bool>      running{false};
+    alignas(CACHE_LINE) std::atomic<uint64_t> applied{0};
+
+    // Written only by this shard's thread
+    PerfRing*              perf = new PerfRing;
+
+    ~Shard() { delete perf; }
+};
+
+static uint32_t event_instrument(const EngineEvent& ev) {
+    switch (ev.header.type) {
+        case EventType::NEW_ORDER:    return ev.new_order.instrument;
+        case EventType::CANCEL:       return ev.cancel.instrument;
+        case EventType::RISK_CONTROL: return ev.risk.instrument;
+        case EventType::TIME_PULSE:   return ev.time.instrument;
+        case EventType::MARKET_ORDER: return ev.market.instrument;
+    }
+    return MAX_INSTRUMENTS;
+}
+
+static void set_instrument(EngineEvent& ev, uint32_t instrument) {
+    switch (ev.header.type) {
+        case EventType::NEW_ORDER:    ev.new_order.instrument = instrument; break;
+        case EventType::CANCEL:       ev.cancel.instrument = instrument; break;
+        case EventType::RISK_CONTROL: ev.risk.instrument = instrument; break;
+        case EventType::TIME_PULSE:   ev.time.instrument = instrument; break;
+        case EventType::MARKET_ORDER: ev.market.instrument = instrument; break;
+    }
+}
+
+ShardedEngine::ShardedEngine(const InstrumentRegistry& registry,
+                             uint32_t shards,
+                             bool pin_cores)
+    : registry_(registry), shard_count_(shards), pin_cores_(pin_cores) {
+    if (shards == 0 || shards > MAX_SHARDS)
+        die("shard count");
+
+    for (uint32_t s = 0; s < shards; ++s)
+        shard_[s] = new Shard();
+
+    for (uint32_t k = 0; k < registry.count; ++k) {
+        uint32_t id = registry.ids[k];
+
+        auto* st = static_cast<EngineState*>(
+            std::calloc(1, sizeof(EngineState)));
+        if (!st) die("calloc");
+
+        init_instrument(*st, registry.specs[id]);
+        states_[id]   = st;
+        shard_of_[id] = k % shards;
+        engines_[id]  = new MatchingEngine(*st, nullptr, nullptr, nullptr,
+                                           nullptr, shard_[k % shards]->perf);
+    }
+}
+
+ShardedEngine::~ShardedEngine() {
+    stop();
+
+    for (uint32_t k = 0; k < registry_.count; ++k) {
+        uint32_t id = registry_.ids[k];
+        delete engines_[id];
+        std::free(states_[id]);
+    }
+    for (uint32_t s = 0; s < shard_count_; ++s)
+        delete shard_[s];
+}
+
+void ShardedEngine::start() {
+    for (uint32_t s = 0; s < shard_count_; ++s) {
+        Shard* sh = shard_[s];
+        if (sh->running.load()) continue;
+
+        sh->running.store(true);
+        sh->thread = std::thread(run, this, sh, s);
+    }
+}
+
+void ShardedEngine::stop() {
+    for (uint32_t s = 0; s < shard_count_; ++s) {
+        Shard* sh = shard_[s];
+        if (!sh->running.load()) continue;
+
+        sh->running.store(false, std::memory_order_release);
+        sh->thread.join();
+    }
+}
+
+uint64_t ShardedEngine::applied(uint32_t shard) const {
+    return shard_[shard]->applied.load(std::memory_order_acquire);
+}
+
+void ShardedEngine::merge_perf(PerfRing& into) const {
+    for (uint32_t s = 0; s < shard_count_; ++s)
+        into.merge(*shard_[s]->perf);
+}
+
+// =======================
+// Routing (producer)
+// =======================
+
+void ShardedEngine::route(uint32_t instrument, EngineEvent ev) {
+    ev.header.sequence = ++next_seq_[instrument];
+    set_instrument(ev, instrument);
+
+    // Ring full: park until the shard pops
+    Shard* sh = shard_[shard_of_[instrument]];
+    while (!sh->ring.try_push(ev)) {
+        uint64_t t = sh->ring.tail();
+        if (sh->ring.try_push(ev)) return;
+        sh->ring.wait_for_space(t);
+    }
+}
+
+void ShardedEngine::submit(const EngineEvent& ev) {
+    bool broadcast =
+        ev.header.type == EventType::TIME_PULSE ||
+        (ev.header.type == EventType::RISK_CONTROL &&
+         ev.risk.command != RiskCommand::LIQUIDATION_MARKET);
+
+    if (broadcast) {
+        for (uint32_t k = 0; k < registry_.count; ++k)
+            route(registry_.ids[k], ev);
+        return;
+    }
+
+    uint32_t instrument = event_instrument(ev);
+    if (!registry_.find(instrument)) {
+        ++unroutable_;
+        return;
+    }
+    route(instrument, ev);
+}
+
+// =======================
+// Shard Loop
+// =======================
+
+void ShardedEngine::run(ShardedEngine* self, Shard* sh, uint32_t index) {
+#if defined(__linux__)
+    if (self->pin_cores_) {
+        unsigned cores = std::thread::hardware_concurrency();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cores ? index % cores : 0, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)index;
+#endif
+
+    EngineEvent batch[SHARD_BATCH];
+    uint32_t idle = 0;
+
+    for (;;) {
+        size_t n = sh->ring.pop_batch(batch, SHARD_BATCH);
+
+        if (n == 0) {
+            if (!sh->running.load(std::memory_order_acquire) &&
+                sh->ring.empty())
+                return;
+
+            // Spin briefly, then give the core up (oversubscribed hosts)
+            if (++idle < 64) cpu_relax();
+            else std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; ++i)
+            self->engines_[event_instrument(batch[i])]->apply(batch[i]);
+
+        sh->applied.fetch_add(n, std::memory_order_release);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "engine.h"
+#include "instruments.h"
+
+#include <atomic>
+#include <thread>
+
+// =======================
+// Sharded Runtime
+// =======================
+//
+// Instruments are dealt round-robin onto `shards` matching threads, each
+// optionally pinned to its own core. A single producer submits events;
+// the router stamps each with its instrument's own contiguous sequence
+// and pushes it onto the owning shard's SPSC ring. Account-wide risk
+// commands (FREEZE, PURGE) and time pulses go to every instrument.
+
+constexpr uint32_t MAX_SHARDS = 64;
+constexpr uint32_t SHARD_RING_SIZE = 1u << 14;
+constexpr size_t   SHARD_BATCH = 256;
+
+class ShardedEngine {
+public:
+    // Every registered instrument gets a zeroed, initialised EngineState.
+    ShardedEngine(const InstrumentRegistry& registry,
+                  uint32_t shards,
+                  bool pin_cores = true);
+    ~ShardedEngine();
+
+    void start();
+
+    // Producer thread only. Events for unknown instruments are dropped
+    // and counted.
+    void submit(const EngineEvent& ev);
+
+    // Apply everything submitted so far, then join the shard threads.
+    void stop();
+
+    // Not synchronised with running shards: call before start / after stop
+    EngineState* state(uint32_t instrument) const { return states_[instrument]; }
+
+    uint32_t shards() const { return shard_count_; }
+    uint32_t shard_of(uint32_t instrument) const { return shard_of_[instrument]; }
+    uint64_t applied(uint32_t shard) const;
+    uint64_t unroutable() const { return unroutable_; }
+
+    // Each shard's engines record into that shard's own PerfRing; this
+    // adds every shard's into `into`. Call after stop, like state().
+    void merge_perf(PerfRing& into) const;
+
+private:
+    struct Shard;
+
+    void route(uint32_t instrument, EngineEvent ev);
+    static void run(ShardedEngine* self, Shard* shard, uint32_t index);
+
+    const InstrumentRegistry& registry_;
+    uint32_t shard_count_;
+    bool     pin_cores_;
+
+    Shard* shard_[MAX_SHARDS] = {};
+
+    EngineState*    states_[MAX_INSTRUMENTS] = {};
+    MatchingEngine* engines_[MAX_INSTRUMENTS] = {};
+    uint32_t        shard_of_[MAX_INSTRUMENTS] = {};
+    uint64_t        next_seq_[MAX_INSTRUMENTS] = {};   // producer side
+
+    uint64_t unroutable_ = 0;
+};
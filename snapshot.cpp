@@ -1,16 +1,40 @@
 #include "snapshot.h"
+#include "state_image.h"
 #include "engine_common.h"
+#include "crc32c.h"
 
 #include <cstdio>      // snprintf, rename
 #include <fcntl.h>     // open
-#include <unistd.h>    // write, fsync, close
-#include <cstdlib>     // abort
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // write, pwrite, read, fsync, close
+#include <cstdlib>     // abort, malloc, free
 #include <cstring>    // memset
 
 static void die(const char*) {
     ENGINE_ABORT("reason");
 }
 
+// Image sink: writes through and keeps the running CRC for the header
+struct ImageWriter {
+    int      fd;
+    uint32_t crc;
+};
+
+static void write_all(const void* p, size_t n, void* ctx) {
+    ImageWriter& out = *static_cast<ImageWriter*>(ctx);
+    out.crc = crc32c(p, n, out.crc);
+
+    int fd = out.fd;
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    while (n > 0) {
+        ssize_t w = ::write(fd, b, n);
+        if (w <= 0)
+            die("write state");
+        b += w;
+        n -= (size_t)w;
+    }
+}
+
 void write_snapshot(const char* path, const EngineState& state) {
     char tmp_path[256];
     std::snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
@@ -24,12 +48,18 @@ void write_snapshot(const char* path, const EngineState& state) {
     hdr.last_sequence = state.last_sequence;
     hdr.last_grc_sequence = state.last_grc_sequence;
     hdr.state_size = sizeof(EngineState);
+    hdr.image_size = state_image_size(state);
 
     if (::write(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr))
         die("write header");
 
-    if (::write(fd, &state, sizeof(state)) != (ssize_t)sizeof(state))
-        die("write state");
+    ImageWriter out{fd, 0};
+    encode_state_image(state, write_all, &out);
+
+    // The CRC is known only once the image is out; patch it in
+    hdr.image_crc = out.crc;
+    if (::pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr))
+        die("write header");
 
     if (::fsync(fd) != 0)
         die("fsync");
@@ -38,4 +68,49 @@ void write_snapshot(const char* path, const EngineState& state) {
 
     if (::rename(tmp_path, path) != 0)
         die("rename snapshot");
-}
\ No newline at end of file
+}
+
+bool load_snapshot(const char* path, EngineState& state) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    SnapshotHeader hdr{};
+    struct stat st{};
+    bool ok =
+        ::read(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+        hdr.magic == SNAPSHOT_MAGIC &&
+        hdr.version == SNAPSHOT_VERSION &&
+        hdr.state_size == sizeof(EngineState) &&
+        hdr.image_size <= sizeof(EngineState) * 2 &&
+        ::fstat(fd, &st) == 0 &&
+        (uint64_t)st.st_size == sizeof(hdr) + hdr.image_size;
+
+    uint8_t* image = nullptr;
+    if (ok) {
+        image = static_cast<uint8_t*>(std::malloc(hdr.image_size));
+        if (!image) die("malloc");
+
+        // A single read() may return short on large files
+        size_t done = 0;
+        while (ok && done < hdr.image_size) {
+            ssize_t n = ::read(fd, image + done, hdr.image_size - done);
+            if (n <= 0) ok = false;
+            else done += (size_t)n;
+        }
+    }
+
+    ::close(fd);
+
+    ok = ok && crc32c(image, hdr.image_size) == hdr.image_crc &&
+         decode_state_image(image, hdr.image_size, state);
+    std::free(image);
+
+    return ok &&
+           state.last_sequence == hdr.last_sequence &&
+           state.last_grc_sequence == hdr.last_grc_sequence;
+}
+
+void read_snapshot(const char* path, EngineState& state) {
+    if (!load_snapshot(path, state))
+        die("read snapshot");
+}
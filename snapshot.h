@@ -3,7 +3,7 @@
 #include <cstdint>
 
 constexpr uint32_t SNAPSHOT_MAGIC = 0x53504150; // "SPAP"
-constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr uint32_t SNAPSHOT_VERSION = 11;
 
 struct SnapshotHeader {
     uint32_t magic;
@@ -11,4 +11,20 @@ struct SnapshotHeader {
     uint64_t last_sequence;
     uint64_t last_grc_sequence;
     uint64_t state_size;
-};
\ No newline at end of file
+    uint64_t image_size;        // StateImage bytes that follow
+    uint32_t image_crc;         // CRC32C of those bytes
+    uint32_t reserved;
+};
+
+// Uncompressed logical image (state_image.h), written to <path>.tmp and
+// renamed into place
+void write_snapshot(const char* path, const EngineState& state);
+
+// `state` must be zeroed. Aborts on a missing or corrupt file.
+void read_snapshot(const char* path, EngineState& state);
+
+// As read_snapshot, but returns false instead of aborting. The image must
+// match the header's CRC, and the header the restored state's
+// last_sequence / last_grc_sequence. `state` is undefined after a false
+// return.
+bool load_snapshot(const char* path, EngineState& state);
\ No newline at end of file
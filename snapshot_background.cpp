@@ -0,0 +1,84 @@
+#include "snapshot_background.h"
+#include "snapshot.h"
+#include "snapshot_lz4.h"
+
+#include <cerrno>
+#include <chrono>
+#include <sys/wait.h>  // waitpid
+#include <unistd.h>    // fork, _exit
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+BackgroundSnapshot::~BackgroundSnapshot() {
+    if (running()) wait();
+}
+
+bool BackgroundSnapshot::start(const char* path,
+                               const EngineState& state,
+                               SnapshotFormat format) {
+    if (running()) return false;
+
+    uint64_t t0 = now_ns();
+    pid_t pid = ::fork();
+
+    if (pid == 0) {
+        // Child: the frozen image. A failed write aborts, which the
+        // parent sees as an abnormal exit. Only the forking thread
+        // exists here, so the writer must not start any: LZ4 compresses
+        // single-threaded.
+        if (format == SnapshotFormat::LZ4)
+            write_snapshot_lz4(path, state, 1);
+        else
+            write_snapshot(path, state);
+        ::_exit(0);
+    }
+
+    uint64_t t1 = now_ns();
+    if (pid < 0) return false;
+
+    pid_ = pid;
+    ok_ = false;
+    sequence_ = state.last_sequence;
+    started_ns_ = t0;
+
+    stall_ns_ = t1 - t0;
+    if (stall_ns_ > max_stall_ns_) max_stall_ns_ = stall_ns_;
+    return true;
+}
+
+void BackgroundSnapshot::reap(int status) {
+    ok_ = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    write_ns_ = now_ns() - started_ns_;
+    pid_ = -1;
+    ++completed_;
+}
+
+bool BackgroundSnapshot::poll() {
+    if (!running()) return true;
+
+    int status = 0;
+    pid_t r = ::waitpid(pid_, &status, WNOHANG);
+    if (r == 0) return false;
+
+    if (r < 0) status = 1 << 8;   // lost the child: report failure
+    reap(status);
+    return true;
+}
+
+bool BackgroundSnapshot::wait() {
+    if (!running()) return ok_;
+
+    int status = 0;
+    pid_t r;
+    do {
+        r = ::waitpid(pid_, &status, 0);
+    } while (r < 0 && errno == EINTR);
+
+    if (r < 0) status = 1 << 8;
+    reap(status);
+    return ok_;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "engine_state.h"
+#include <cstdint>
+#include <sys/types.h>
+
+// =======================
+// Background Snapshots
+// =======================
+//
+// start() fork()s. The child inherits a copy-on-write image of the whole
+// address space frozen at that instant, writes it with write_snapshot /
+// write_snapshot_lz4 and exits, while the parent goes straight back to
+// apply(). The only pause on the matching thread is fork() itself (page
+// table copy); later first writes to shared pages take a COW fault each.
+//
+// glibc re-initialises malloc in the child, so this is safe with the
+// publisher thread running; the child touches nothing else of it and
+// starts no threads of its own (LZ4 compresses on the child's one thread).
+
+enum class SnapshotFormat : uint8_t {
+    RAW,
+    LZ4
+};
+
+class BackgroundSnapshot {
+public:
+    ~BackgroundSnapshot();
+
+    // False if one is already running or fork() fails.
+    bool start(const char* path,
+               const EngineState& state,
+               SnapshotFormat format);
+
+    bool running() const { return pid_ > 0; }
+
+    // Non-blocking; true once the child has exited (result in ok()).
+    bool poll();
+
+    // Block until the child exits; returns ok().
+    bool wait();
+
+    bool ok() const { return ok_; }
+
+    uint64_t sequence() const      { return sequence_; }   // captured at
+    uint64_t stall_ns() const      { return stall_ns_; }   // fork() on caller
+    uint64_t max_stall_ns() const  { return max_stall_ns_; }
+    uint64_t write_ns() const      { return write_ns_; }   // start -> reaped
+    uint64_t completed() const     { return completed_; }
+
+private:
+    void reap(int status);
+
+    pid_t    pid_ = -1;
+    bool     ok_ = false;
+    uint64_t sequence_ = 0;
+    uint64_t started_ns_ = 0;
+
+    uint64_t stall_ns_ = 0;
+    uint64_t max_stall_ns_ = 0;
+    uint64_t write_ns_ = 0;
+    uint64_t completed_ = 0;
+};
@@ -1,67 +1,198 @@
 #include "snapshot_delta.h"
+#include "crc32c.h"
 
 #include <cstdint>   // uint8_t
-#include <cstddef>   // size_t
+#include <cstddef>   // size_t, offsetof
 #include <cstdio>    // snprintf, rename
 #include <cstdlib>   // abort, malloc, free
-#include <cstring>   // memset
+#include <cstring>   // memcpy
 #include <fcntl.h>   // open
-#include <unistd.h>  // write, fsync, close
+#include <sys/stat.h> // fstat
+#include <sys/uio.h> // writev
+#include <unistd.h>  // write, read, lseek, fsync, close
 #include "engine_common.h"
 
 static void die(const char*) {
     ENGINE_ABORT("reason");
 }
 
+static void write_all(int fd, const void* p, size_t n) {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    while (n > 0) {
+        ssize_t w = ::write(fd, b, n);
+        if (w <= 0)
+            die("write delta");
+        b += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
 void write_delta_snapshot(const char* path,
-                          const EngineState& base,
-                          const EngineState& current) {
+                          const EngineState& current,
+                          uint64_t base_sequence,
+                          const DirtyTracker& dirty) {
     char tmp[256];
     std::snprintf(tmp, sizeof(tmp), "%s.tmp", path);
 
-    // -----------------------
-    // Allocate delta on heap
-    // -----------------------
-    EngineState* delta =
-        static_cast<EngineState*>(std::malloc(sizeof(EngineState)));
-    if (!delta)
-        die("malloc");
-
-    std::memset(delta, 0, sizeof(EngineState));
-
-    const uint8_t* b = reinterpret_cast<const uint8_t*>(&base);
-    const uint8_t* c = reinterpret_cast<const uint8_t*>(&current);
-    uint8_t*       d = reinterpret_cast<uint8_t*>(delta);
-
-    for (size_t i = 0; i < sizeof(EngineState); ++i)
-        d[i] = static_cast<uint8_t>(b[i] ^ c[i]);
-
-    // -----------------------
-    // Write snapshot
-    // -----------------------
     int fd = ::open(tmp, O_CREAT | O_TRUNC | O_WRONLY, 0644);
     if (fd < 0)
         die("open");
 
+    // Header is rewritten once the ranges are known
     DeltaSnapshotHeader hdr{};
-    hdr.base_sequence  = base.last_sequence;
+    hdr.magic          = DELTA_SNAPSHOT_MAGIC;
+    hdr.version        = DELTA_SNAPSHOT_VERSION;
+    hdr.base_sequence  = base_sequence;
     hdr.delta_sequence = current.last_sequence;
     hdr.size           = sizeof(EngineState);
 
-    if (::write(fd, &hdr, sizeof(hdr))
-        != static_cast<ssize_t>(sizeof(hdr)))
-        die("write header");
+    if (::lseek(fd, static_cast<off_t>(sizeof(hdr)), SEEK_SET) < 0)
+        die("seek");
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(&current);
+    uint32_t crc = 0;
+
+    // -----------------------
+    // Runs of dirty pages
+    // -----------------------
+    size_t pg = 0;
+    while (pg < DIRTY_PAGES) {
+        if (!dirty.test(pg)) {
+            ++pg;
+            continue;
+        }
+
+        size_t end = pg + 1;
+        while (end < DIRTY_PAGES && dirty.test(end)) ++end;
+
+        DeltaRange r;
+        r.offset = pg * DIRTY_PAGE_BYTES;
+        r.length = end * DIRTY_PAGE_BYTES - r.offset;
+        if (r.offset + r.length > sizeof(EngineState))
+            r.length = sizeof(EngineState) - r.offset;
+
+        crc = crc32c(&r, sizeof(r), crc);
+        crc = crc32c(src + r.offset, r.length, crc);
+
+        iovec iov[2];
+        iov[0].iov_base = &r;
+        iov[0].iov_len  = sizeof(r);
+        iov[1].iov_base = const_cast<uint8_t*>(src + r.offset);
+        iov[1].iov_len  = r.length;
+
+        size_t want = sizeof(r) + r.length;
+        ssize_t w = ::writev(fd, iov, 2);
+        if (w < 0)
+            die("write delta");
+        if (static_cast<size_t>(w) < want) {
+            // Short write: finish the remainder plainly
+            size_t done = static_cast<size_t>(w);
+            if (done < sizeof(r)) {
+                write_all(fd, reinterpret_cast<uint8_t*>(&r) + done,
+                          sizeof(r) - done);
+                done = sizeof(r);
+            }
+            write_all(fd, src + r.offset + (done - sizeof(r)),
+                      want - done);
+        }
+
+        ++hdr.range_count;
+        hdr.payload_bytes += want;
+        pg = end;
+    }
+
+    hdr.crc = crc;
 
-    if (::write(fd, delta, sizeof(EngineState))
-        != static_cast<ssize_t>(sizeof(EngineState)))
-        die("write delta");
+    if (::lseek(fd, 0, SEEK_SET) < 0)
+        die("seek");
+    write_all(fd, &hdr, sizeof(hdr));
 
     if (::fsync(fd) != 0)
         die("fsync");
 
     ::close(fd);
-    std::free(delta);
 
     if (::rename(tmp, path) != 0)
         die("rename");
-}
\ No newline at end of file
+}
+
+bool apply_delta_snapshot(const char* path, EngineState& state) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    DeltaSnapshotHeader hdr{};
+    struct stat st{};
+    bool ok =
+        ::read(fd, &hdr, sizeof(hdr)) == static_cast<ssize_t>(sizeof(hdr)) &&
+        hdr.magic == DELTA_SNAPSHOT_MAGIC &&
+        hdr.version == DELTA_SNAPSHOT_VERSION &&
+        hdr.size == sizeof(EngineState) &&
+        hdr.base_sequence == state.last_sequence &&
+        ::fstat(fd, &st) == 0 &&
+        static_cast<uint64_t>(st.st_size) == sizeof(hdr) + hdr.payload_bytes;
+
+    // Whole payload is read and checked before `state` is touched
+    uint8_t* buf = nullptr;
+    if (ok) {
+        buf = static_cast<uint8_t*>(
+            std::malloc(hdr.payload_bytes ? hdr.payload_bytes : 1));
+        if (!buf)
+            die("malloc");
+
+        size_t done = 0;
+        while (ok && done < hdr.payload_bytes) {
+            ssize_t n = ::read(fd, buf + done, hdr.payload_bytes - done);
+            if (n <= 0) ok = false;
+            else done += static_cast<size_t>(n);
+        }
+
+        ok = ok && crc32c(buf, hdr.payload_bytes) == hdr.crc;
+    }
+
+    ::close(fd);
+
+    // Ranges must tile the payload and stay inside EngineState, and the
+    // new last_sequence must be among them
+    if (ok) {
+        const uint64_t seq_off = offsetof(EngineState, last_sequence);
+        uint64_t seq = state.last_sequence;
+
+        uint64_t pos = 0;
+        for (uint64_t i = 0; ok && i < hdr.range_count; ++i) {
+            DeltaRange r;
+            ok = pos + sizeof(r) <= hdr.payload_bytes;
+            if (!ok) break;
+
+            std::memcpy(&r, buf + pos, sizeof(r));
+            pos += sizeof(r);
+
+            ok = r.offset <= sizeof(EngineState) &&
+                 r.length <= sizeof(EngineState) - r.offset &&
+                 r.length <= hdr.payload_bytes - pos;
+
+            if (ok && seq_off >= r.offset &&
+                seq_off + sizeof(seq) <= r.offset + r.length)
+                std::memcpy(&seq, buf + pos + (seq_off - r.offset), sizeof(seq));
+
+            pos += r.length;
+        }
+        ok = ok && pos == hdr.payload_bytes && seq == hdr.delta_sequence;
+    }
+
+    if (ok) {
+        uint8_t* dst = reinterpret_cast<uint8_t*>(&state);
+
+        uint64_t pos = 0;
+        for (uint64_t i = 0; i < hdr.range_count; ++i) {
+            DeltaRange r;
+            std::memcpy(&r, buf + pos, sizeof(r));
+            pos += sizeof(r);
+            std::memcpy(dst + r.offset, buf + pos, r.length);
+            pos += r.length;
+        }
+    }
+
+    std::free(buf);
+    return ok;
+}
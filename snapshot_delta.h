@@ -1,9 +1,47 @@
 #pragma once
 #include "engine_state.h"
+#include "dirty_tracker.h"
 #include <cstdint>
 
+// =======================
+// Delta Snapshot Format
+// =======================
+//
+//   [DeltaSnapshotHeader]
+//   ([DeltaRange] [length bytes of EngineState at offset]) * range_count
+//
+// Ranges are the runs of pages marked in a DirtyTracker since the base
+// snapshot. `crc` is CRC32C over everything after the header.
+
+constexpr uint32_t DELTA_SNAPSHOT_MAGIC = 0x53504454; // "SPDT"
+constexpr uint32_t DELTA_SNAPSHOT_VERSION = 10;
+
 struct DeltaSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
     uint64_t base_sequence;
     uint64_t delta_sequence;
-    uint64_t size;
-};
\ No newline at end of file
+    uint64_t size;              // sizeof(EngineState)
+    uint64_t range_count;
+    uint64_t payload_bytes;     // bytes after the header
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+struct DeltaRange {
+    uint64_t offset;
+    uint64_t length;
+};
+
+// Pages of `current` marked in `dirty`. The tracker must have been cleared
+// when the snapshot at `base_sequence` was taken; clear it again after this
+// call to start the next link of the chain.
+void write_delta_snapshot(const char* path,
+                          const EngineState& current,
+                          uint64_t base_sequence,
+                          const DirtyTracker& dirty);
+
+// Apply the delta at `path` to `state` in place. Returns false (leaving
+// `state` untouched) if the file is missing or corrupt, or if `state` is
+// not at the delta's base_sequence.
+bool apply_delta_snapshot(const char* path, EngineState& state);
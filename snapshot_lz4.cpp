@@ -1,117 +1,422 @@
 #include "snapshot_lz4.h"
+#include "crc32c.h"
+#include "state_image.h"
 
 #include <lz4.h>
 
+#include <atomic>
 #include <cstdio>    // snprintf, rename
 #include <cstdlib>   // abort, malloc, free
-#include <cstring>   // memcpy
+#include <cstring>   // memcpy, memset
 #include <fcntl.h>   // open
-#include <unistd.h>  // write, fsync, close
+#include <thread>
+#include <vector>
+#include <unistd.h>  // write, pread, lseek, fsync, close
 #include "engine_common.h"
 
-constexpr uint32_t SNAPSHOT_MAGIC_LZ4 = 0x53504C34; // "SPL4"
-constexpr uint32_t SNAPSHOT_VERSION_LZ4 = 1;
-
 static void die(const char*) {
     ENGINE_ABORT("reason");
 }
 
-void write_snapshot_lz4(const char* path, const EngineState& state) {
-    char tmp[256];
-    std::snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+static_assert(SNAPSHOT_LZ4_CHUNK <= static_cast<uint32_t>(INT32_MAX),
+              "LZ4 block sizes must fit in int");
+static_assert(SNAPSHOT_LZ4_CHUNK >= sizeof(StateImageHeader),
+              "the image header must fit in chunk 0");
 
-    const size_t src_size = sizeof(EngineState);
+static uint32_t pool_size(uint32_t threads, uint32_t chunks) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    if (threads > chunks) threads = chunks;
+    return threads;
+}
 
-    // LZ4 API limitation: sizes must fit in int
-    if (src_size > static_cast<size_t>(INT32_MAX))
-        die("EngineState too large for LZ4");
+static size_t chunk_bytes(uint32_t i, uint32_t chunk_size, size_t total) {
+    size_t off = static_cast<size_t>(i) * chunk_size;
+    size_t n = total - off;
+    return n < chunk_size ? n : chunk_size;
+}
 
-    const char* src = reinterpret_cast<const char*>(&state);
-    const int src_size_i = static_cast<int>(src_size);
+static bool all_zero(const uint8_t* p, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        if (w) return false;
+    }
+    for (; i < n; ++i)
+        if (p[i]) return false;
+    return true;
+}
 
-    const int max_dst = LZ4_compressBound(src_size_i);
-    if (max_dst <= 0)
-        die("LZ4_compressBound");
+static void write_all(int fd, const void* p, size_t n) {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    while (n > 0) {
+        ssize_t w = ::write(fd, b, n);
+        if (w <= 0)
+            die("write");
+        b += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+// =======================
+// Write
+// =======================
 
-    char* dst = static_cast<char*>(std::malloc(static_cast<size_t>(max_dst)));
-    if (!dst)
-        die("malloc");
+// One in-flight chunk: its raw bytes and their compressed form. The
+// encoder fills slot i % slots with chunk i and publishes ready = i + 1;
+// a worker compresses it and publishes done = i + 1.
+struct alignas(64) ChunkSlot {
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> done;
+    uint8_t*              raw;
+    char*                 buf;
+    uint32_t              size;
+    uint32_t              crc;
+};
 
-    const int compressed =
-        LZ4_compress_default(src, dst, src_size_i, max_dst);
+// Compresses the `n` raw bytes of `slot` into its buffer
+static void compress_slot(ChunkSlot& slot, size_t n, int bound) {
+    if (all_zero(slot.raw, n)) {
+        slot.size = 0;
+        slot.crc = 0;
+        return;
+    }
 
-    if (compressed <= 0)
+    int c = LZ4_compress_default(reinterpret_cast<const char*>(slot.raw),
+                                 slot.buf, static_cast<int>(n), bound);
+    if (c <= 0)
         die("LZ4_compress_default");
+    slot.size = static_cast<uint32_t>(c);
+    slot.crc = crc32c(slot.buf, slot.size);
+}
+
+// The image sink: cuts the encoder's output into chunks as it arrives.
+// Before a slot takes its next chunk, the chunk it held is written out,
+// so chunks reach the file in order and at most `slots` are held.
+struct ChunkStream {
+    ChunkSlot*            ring;
+    uint32_t              slots;
+    uint32_t              chunks;
+    size_t                image_size;
+    int                   fd;
+    CompressedChunkEntry* index;
+    uint64_t              offset;    // file offset of the next payload
+    int                   bound;     // > 0: no pool, compress in put()
+    uint32_t              chunk = 0; // being filled
+    size_t                fill = 0;  // its bytes so far
+
+    void drain(uint32_t i) {
+        ChunkSlot& slot = ring[i % slots];
+        for (uint32_t d;
+             (d = slot.done.load(std::memory_order_acquire)) != i + 1;)
+            slot.done.wait(d, std::memory_order_acquire);
+
+        index[i].offset = offset;
+        index[i].size   = slot.size;
+        index[i].crc    = slot.crc;
+
+        write_all(fd, slot.buf, slot.size);
+        offset += slot.size;
+    }
+
+    void put(const uint8_t* p, size_t n) {
+        while (n > 0) {
+            if (chunk >= chunks) die("image larger than sized");
+            ChunkSlot& slot = ring[chunk % slots];
+            if (fill == 0 && chunk >= slots)
+                drain(chunk - slots);
+
+            size_t want = chunk_bytes(chunk, SNAPSHOT_LZ4_CHUNK, image_size);
+            size_t take = want - fill < n ? want - fill : n;
+            std::memcpy(slot.raw + fill, p, take);
+            fill += take;
+            p += take;
+            n -= take;
+
+            if (fill == want && bound > 0) {
+                compress_slot(slot, want, bound);
+                slot.done.store(chunk + 1, std::memory_order_relaxed);
+                ++chunk;
+                fill = 0;
+            } else if (fill == want) {
+                slot.ready.store(chunk + 1, std::memory_order_release);
+                slot.ready.notify_all();
+                ++chunk;
+                fill = 0;
+            }
+        }
+    }
+};
+
+void write_snapshot_lz4(const char* path,
+                        const EngineState& state,
+                        uint32_t threads) {
+    char tmp[256];
+    std::snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    const size_t image_size = state_image_size(state);
+    const uint32_t chunks = static_cast<uint32_t>(
+        (image_size + SNAPSHOT_LZ4_CHUNK - 1) / SNAPSHOT_LZ4_CHUNK);
+    const uint32_t workers = pool_size(threads, chunks);
+    const uint32_t slots = workers * 2;
+    const int bound = LZ4_compressBound(static_cast<int>(SNAPSHOT_LZ4_CHUNK));
+    if (bound <= 0)
+        die("LZ4_compressBound");
+
+    // Memory is slots x (chunk + bound), whatever the image size
+    auto* ring = new ChunkSlot[slots];
+    for (uint32_t s = 0; s < slots; ++s) {
+        ring[s].ready.store(0, std::memory_order_relaxed);
+        ring[s].done.store(0, std::memory_order_relaxed);
+        ring[s].raw = static_cast<uint8_t*>(std::malloc(SNAPSHOT_LZ4_CHUNK));
+        ring[s].buf = static_cast<char*>(std::malloc(static_cast<size_t>(bound)));
+        if (!ring[s].raw || !ring[s].buf)
+            die("malloc");
+    }
+
+    auto* index = static_cast<CompressedChunkEntry*>(
+        std::calloc(chunks, sizeof(CompressedChunkEntry)));
+    if (!index)
+        die("calloc");
 
     int fd = ::open(tmp, O_CREAT | O_TRUNC | O_WRONLY, 0644);
     if (fd < 0)
         die("open");
 
+    const uint64_t data_start =
+        sizeof(CompressedSnapshotHeader) +
+        uint64_t(chunks) * sizeof(CompressedChunkEntry);
+    if (::lseek(fd, static_cast<off_t>(data_start), SEEK_SET) < 0)
+        die("seek");
+
+    // -----------------------
+    // Compress (pool)
+    // -----------------------
+    std::atomic<uint32_t> next{0};
+
+    auto worker = [&]() {
+        for (;;) {
+            uint32_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= chunks) return;
+
+            ChunkSlot& slot = ring[i % slots];
+            for (uint32_t r;
+                 (r = slot.ready.load(std::memory_order_acquire)) != i + 1;)
+                slot.ready.wait(r, std::memory_order_acquire);
+
+            compress_slot(slot,
+                          chunk_bytes(i, SNAPSHOT_LZ4_CHUNK, image_size),
+                          bound);
+
+            slot.done.store(i + 1, std::memory_order_release);
+            slot.done.notify_all();
+        }
+    };
+
+    // One worker would only trade places with the encoder: compress on
+    // this thread instead and start none (a fork()ed child may not)
+    const bool pooled = workers > 1;
+    std::vector<std::thread> pool;
+    pool.reserve(pooled ? workers : 0);
+    for (uint32_t w = 0; pooled && w < workers; ++w)
+        pool.emplace_back(worker);
+
+    // -----------------------
+    // Encode, streaming out in order
+    // -----------------------
+    ChunkStream out{ring, slots, chunks, image_size, fd, index, data_start,
+                    pooled ? 0 : bound};
+    encode_state_image(state,
+        [](const void* p, size_t n, void* ctx) {
+            static_cast<ChunkStream*>(ctx)->put(
+                static_cast<const uint8_t*>(p), n);
+        }, &out);
+
+    if (out.chunk != chunks)
+        die("image smaller than sized");
+    for (uint32_t i = chunks > slots ? chunks - slots : 0; i < chunks; ++i)
+        out.drain(i);
+
+    for (std::thread& t : pool)
+        t.join();
+
     CompressedSnapshotHeader hdr{};
     hdr.magic = SNAPSHOT_MAGIC_LZ4;
     hdr.version = SNAPSHOT_VERSION_LZ4;
     hdr.last_sequence = state.last_sequence;
     hdr.last_grc_sequence = state.last_grc_sequence;
-    hdr.uncompressed_size = static_cast<uint64_t>(src_size);
-    hdr.compressed_size   = static_cast<uint64_t>(compressed);
-
-    if (::write(fd, &hdr, sizeof(hdr)) != static_cast<ssize_t>(sizeof(hdr)))
-        die("write header");
+    hdr.uncompressed_size = image_size;
+    hdr.compressed_size   = out.offset - data_start;
+    hdr.chunk_size  = SNAPSHOT_LZ4_CHUNK;
+    hdr.chunk_count = chunks;
 
-    if (::write(fd, dst, static_cast<size_t>(compressed))
-        != static_cast<ssize_t>(compressed))
-        die("write data");
+    if (::lseek(fd, 0, SEEK_SET) < 0)
+        die("seek");
+    write_all(fd, &hdr, sizeof(hdr));
+    write_all(fd, index, chunks * sizeof(CompressedChunkEntry));
 
     if (::fsync(fd) != 0)
         die("fsync");
 
     ::close(fd);
-    std::free(dst);
+
+    for (uint32_t s = 0; s < slots; ++s) {
+        std::free(ring[s].raw);
+        std::free(ring[s].buf);
+    }
+    delete[] ring;
+    std::free(index);
 
     if (::rename(tmp, path) != 0)
         die("rename");
 }
 
-void read_snapshot_lz4(const char* path, EngineState& state) {
+// =======================
+// Read
+// =======================
+
+// Chunk i of the file into `out` (chunk_bytes long), through `buf`
+static bool inflate_chunk(int fd, const CompressedChunkEntry& e, char* buf,
+                          uint8_t* out, size_t n) {
+    return ::pread(fd, buf, e.size, static_cast<off_t>(e.offset)) ==
+               static_cast<ssize_t>(e.size) &&
+           crc32c(buf, e.size) == e.crc &&
+           LZ4_decompress_safe(buf, reinterpret_cast<char*>(out),
+                               static_cast<int>(e.size),
+                               static_cast<int>(n)) ==
+               static_cast<int>(n);
+}
+
+bool load_snapshot_lz4(const char* path,
+                       EngineState& state,
+                       uint32_t threads) {
     int fd = ::open(path, O_RDONLY);
     if (fd < 0)
-        die("open");
+        return false;
 
+    // The image header must sit whole in chunk 0
     CompressedSnapshotHeader hdr{};
-    if (::read(fd, &hdr, sizeof(hdr)) != static_cast<ssize_t>(sizeof(hdr)))
-        die("read header");
+    bool ok =
+        ::pread(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr)) &&
+        hdr.magic == SNAPSHOT_MAGIC_LZ4 &&
+        hdr.version == SNAPSHOT_VERSION_LZ4 &&
+        hdr.uncompressed_size <= sizeof(EngineState) * 2 &&
+        hdr.uncompressed_size >= sizeof(StateImageHeader) &&
+        hdr.chunk_size >= sizeof(StateImageHeader) &&
+        hdr.chunk_size <= SNAPSHOT_LZ4_CHUNK &&
+        uint64_t(hdr.chunk_count) ==
+            (hdr.uncompressed_size + hdr.chunk_size - 1) / hdr.chunk_size;
+
+    CompressedChunkEntry* index = nullptr;
+    if (ok) {
+        size_t bytes = hdr.chunk_count * sizeof(CompressedChunkEntry);
+        index = static_cast<CompressedChunkEntry*>(std::malloc(bytes));
+        if (!index)
+            die("malloc");
+        ok = ::pread(fd, index, bytes, sizeof(hdr)) ==
+             static_cast<ssize_t>(bytes);
+    }
+
+    // Payloads must be laid out back to back after the index
+    const int bound = ok ? LZ4_compressBound(static_cast<int>(hdr.chunk_size)) : 0;
+    if (ok) {
+        uint64_t offset = sizeof(hdr) +
+                          uint64_t(hdr.chunk_count) * sizeof(CompressedChunkEntry);
+        for (uint32_t i = 0; ok && i < hdr.chunk_count; ++i) {
+            ok = index[i].offset == offset &&
+                 index[i].size <= static_cast<uint32_t>(bound);
+            offset += index[i].size;
+        }
+        ok = ok && offset - sizeof(hdr) -
+                   uint64_t(hdr.chunk_count) * sizeof(CompressedChunkEntry) ==
+                   hdr.compressed_size;
+    }
+
+    // -----------------------
+    // Decompress (pool), each chunk into its tables
+    // -----------------------
+    // Chunk 0 goes first, for the header that lays out the rest. Every
+    // worker then holds one compressed and one raw chunk at most.
+    StateImageDecoder image(state);
+    if (ok) {
+        char* buf = static_cast<char*>(std::malloc(static_cast<size_t>(bound)));
+        uint8_t* raw = static_cast<uint8_t*>(std::malloc(hdr.chunk_size));
+        if (!buf || !raw)
+            die("malloc");
+
+        size_t n = chunk_bytes(0, hdr.chunk_size, hdr.uncompressed_size);
+        ok = index[0].size != 0 &&
+             inflate_chunk(fd, index[0], buf, raw, n) &&
+             image.begin(raw, hdr.uncompressed_size);
+        if (ok)
+            image.place(0, raw, n);
+
+        std::free(buf);
+        std::free(raw);
+    }
+
+    if (ok) {
+        std::atomic<uint32_t> next{1};
+        std::atomic<bool> failed{false};
 
-    if (hdr.magic != SNAPSHOT_MAGIC_LZ4)
-        die("bad magic");
+        auto worker = [&]() {
+            char* buf = static_cast<char*>(std::malloc(static_cast<size_t>(bound)));
+            uint8_t* raw = static_cast<uint8_t*>(std::malloc(hdr.chunk_size));
+            if (!buf || !raw)
+                die("malloc");
 
-    if (hdr.version != SNAPSHOT_VERSION_LZ4)
-        die("bad version");
+            for (;;) {
+                uint32_t i = next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= hdr.chunk_count || failed.load(std::memory_order_relaxed))
+                    break;
 
-    if (hdr.uncompressed_size != sizeof(EngineState))
-        die("state size mismatch");
+                uint64_t off = uint64_t(i) * hdr.chunk_size;
+                size_t n = chunk_bytes(i, hdr.chunk_size, hdr.uncompressed_size);
+                const CompressedChunkEntry& e = index[i];
 
-    if (hdr.compressed_size > static_cast<uint64_t>(INT32_MAX))
-        die("compressed snapshot too large");
+                // Zeroed target: zero chunks need no work at all
+                if (e.size == 0)
+                    continue;
 
-    char* buf =
-        static_cast<char*>(std::malloc(static_cast<size_t>(hdr.compressed_size)));
-    if (!buf)
-        die("malloc");
+                // Straight into the table when the chunk is all one
+                uint8_t* dst = image.target(off, n);
+                bool good = inflate_chunk(fd, e, buf, dst ? dst : raw, n);
+                if (good && !dst)
+                    image.place(off, raw, n);
 
-    if (::read(fd, buf, static_cast<size_t>(hdr.compressed_size))
-        != static_cast<ssize_t>(hdr.compressed_size))
-        die("read data");
+                if (!good)
+                    failed.store(true, std::memory_order_relaxed);
+            }
 
-    const int decompressed =
-        LZ4_decompress_safe(
-            buf,
-            reinterpret_cast<char*>(&state),
-            static_cast<int>(hdr.compressed_size),
-            static_cast<int>(hdr.uncompressed_size));
+            std::free(buf);
+            std::free(raw);
+        };
 
-    if (decompressed < 0)
-        die("LZ4_decompress_safe");
+        uint32_t workers = pool_size(threads, hdr.chunk_count);
+        std::vector<std::thread> pool;
+        pool.reserve(workers);
+        for (uint32_t w = 0; w < workers; ++w)
+            pool.emplace_back(worker);
+        for (std::thread& t : pool)
+            t.join();
+
+        ok = !failed.load();
+    }
 
     ::close(fd);
-    std::free(buf);
-}
\ No newline at end of file
+    std::free(index);
+
+    ok = ok && image.finish();
+
+    return ok &&
+           state.last_sequence == hdr.last_sequence &&
+           state.last_grc_sequence == hdr.last_grc_sequence;
+}
+
+void read_snapshot_lz4(const char* path,
+                       EngineState& state,
+                       uint32_t threads) {
+    if (!load_snapshot_lz4(path, state, threads))
+        die("read snapshot");
+}
@@ -4,26 +4,65 @@
 #include <cstdint>
 
 // =======================
-// LZ4 Snapshot Header
+// LZ4 Snapshot Format
 // =======================
+//
+//   [CompressedSnapshotHeader]
+//   [CompressedChunkEntry] * chunk_count
+//   [chunk payloads, in order]
+//
+// The logical state image (state_image.h) is cut into SNAPSHOT_LZ4_CHUNK-
+// byte chunks, each an independent LZ4 block, so both directions run
+// across a thread pool. All-zero chunks are stored as size 0 and cost
+// nothing to write or restore.
+//
+// Neither direction holds the whole image: the writer compresses chunks
+// as the encoder produces them, the reader inflates each one into the
+// tables it covers (StateImageDecoder), so either needs a couple of
+// chunks per thread beyond the state itself.
+
+constexpr uint32_t SNAPSHOT_MAGIC_LZ4 = 0x53504C34; // "SPL4"
+constexpr uint32_t SNAPSHOT_VERSION_LZ4 = 11;
+
+constexpr uint32_t SNAPSHOT_LZ4_CHUNK = 4u << 20;
 
 struct CompressedSnapshotHeader {
     uint32_t magic;
     uint32_t version;
     uint64_t last_sequence;
     uint64_t last_grc_sequence;
-    uint64_t uncompressed_size;
-    uint64_t compressed_size;
+    uint64_t uncompressed_size;   // state image bytes
+    uint64_t compressed_size;     // sum of chunk payloads
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+};
+
+struct CompressedChunkEntry {
+    uint64_t offset;              // file offset of the payload
+    uint32_t size;                // compressed bytes; 0 = all-zero chunk
+    uint32_t crc;                 // CRC32C of the payload
 };
 
 // =======================
 // API
 // =======================
 
+// `threads` = 0 uses every hardware thread. A writer given 1 starts no
+// thread at all and compresses on the caller's.
+
 // Write full EngineState snapshot compressed with LZ4
 void write_snapshot_lz4(const char* path,
-                        const EngineState& state);
+                        const EngineState& state,
+                        uint32_t threads = 0);
 
-// Read full EngineState snapshot compressed with LZ4
+// Read full EngineState snapshot compressed with LZ4 (`state` must be
+// zeroed)
 void read_snapshot_lz4(const char* path,
-                       EngineState& state);
\ No newline at end of file
+                       EngineState& state,
+                       uint32_t threads = 0);
+
+// As read_snapshot_lz4, but returns false instead of aborting on a missing
+// or corrupt file. `state` is undefined after a false return.
+bool load_snapshot_lz4(const char* path,
+                       EngineState& state,
+                       uint32_t threads = 0);
@@ -1,9 +1,585 @@
 #include "engine.h"
+#include "snapshot.h"
 #include "snapshot_lz4.h"
+#include "snapshot_delta.h"
+#include "journal.h"
+#include "recovery.h"
+#include "snapshot_background.h"
+#include "state_image.h"
+#include "instruments.h"
 #include "engine_common.h"
 
+#include <random>
+#include <cstddef>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr const char* RECOVERY_JOURNAL_DIR  = "snapshot_test_journal.d";
+constexpr const char* RECOVERY_SNAPSHOT_DIR = "snapshot_test_snaps.d";
+
+constexpr uint64_t RECOVERY_EVENTS = 30'000;
+constexpr uint64_t RAW_AT   = 10'000;
+constexpr uint64_t LZ4_AT   = 20'000;
+constexpr uint64_t DELTA_AT = 25'000;
+constexpr uint64_t DELTA2_AT = 28'000;
+
+static void snap_path(char* out, size_t n, const char* name) {
+    std::snprintf(out, n, "%s/%s", RECOVERY_SNAPSHOT_DIR, name);
+}
+
+// Mixed traffic over accounts 0..99 with occasional risk events
+static void random_event(EngineEvent& ev, uint64_t seq,
+                         const EngineState& state,
+                         std::mt19937_64& rng, uint64_t& grc) {
+    ev = EngineEvent{};
+    ev.header.sequence = seq;
+
+    if (rng() % 500 == 0) {
+        // Freeze a never-seen account (opens it) or purge a live one
+        ev.header.type = EventType::RISK_CONTROL;
+        ev.risk.grc_sequence = ++grc;
+        if (rng() % 2) {
+            ev.risk.command    = RiskCommand::ACCOUNT_FREEZE;
+            ev.risk.account_id = 100 + grc;
+        } else {
+            ev.risk.command    = RiskCommand::PURGE_ORDERS;
+            ev.risk.account_id = rng() % 100;
+        }
+    } else if (state.orders.slot_top > 1 && rng() % 4 == 0) {
+        // Current id of a random slot: live, or already filled / cancelled
+        ev.header.type = EventType::CANCEL;
+        ev.cancel.order_id =
+            state.orders.cold[1 + rng() % (state.orders.slot_top - 1)].id;
+    } else {
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = rng() % 100;
+        ev.new_order.side       = static_cast<uint8_t>(rng() % 2);
+        ev.new_order.price      = 1'000'000 + static_cast<int64_t>(rng() % 500);
+        ev.new_order.quantity   = static_cast<int64_t>(rng() % 10) + 1;
+    }
+}
+
+static EngineState* seeded_state() {
+    auto* s = static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    for (uint64_t i = 0; i < 100; ++i) {
+        uint32_t slot = s->accounts.open(i);
+        s->accounts.hot[slot].base_available  = 1'000'000'000;
+        s->accounts.hot[slot].quote_available = 1'000'000'000;
+    }
+    return s;
+}
+
+// ------------------------------------------------------------
+// Snapshot chain + journal tail must rebuild the live state
+// ------------------------------------------------------------
+static void test_recovery() {
+    auto* live = seeded_state();
+    auto* base =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    DirtyTracker dirty(*live);
+    StateDigest digest;
+    MatchingEngine engine(*live, nullptr, &dirty, nullptr, &digest);
+
+    journal_remove_segments(RECOVERY_JOURNAL_DIR);
+    ::mkdir(RECOVERY_SNAPSHOT_DIR, 0755);
+
+    char raw[320], lz4[320], delta[320], delta2[320], torn[320];
+    snap_path(raw,   sizeof(raw),   "a.snap");
+    snap_path(lz4,   sizeof(lz4),   "b.snap.lz4");
+    snap_path(delta, sizeof(delta), "c.delta");
+    snap_path(delta2, sizeof(delta2), "d.delta");
+    snap_path(torn,  sizeof(torn),  "e.snap");
+
+    JournalConfig jcfg;
+    jcfg.dir = RECOVERY_JOURNAL_DIR;
+    jcfg.segment_records = 1u << 13;
+    auto* log = new JournalWriter(jcfg);
+
+    std::mt19937_64 rng(777);
+    uint64_t grc = 0;
+
+    for (uint64_t seq = 1; seq <= RECOVERY_EVENTS; ++seq) {
+        EngineEvent ev;
+        random_event(ev, seq, *live, rng, grc);
+
+        log->append(ev);
+        engine.apply(ev);
+
+        if (seq == RAW_AT) write_snapshot(raw, *live);
+        if (seq == LZ4_AT) {
+            write_snapshot_lz4(lz4, *live);
+            std::memcpy(base, live, sizeof(EngineState));
+            dirty.clear();
+        }
+        if (seq == DELTA_AT) {
+            write_delta_snapshot(delta, *live, LZ4_AT, dirty);
+            dirty.clear();
+
+            // Base + delta alone must reproduce the live state
+            if (!apply_delta_snapshot(delta, *base) ||
+                std::memcmp(base, live, sizeof(EngineState)) != 0)
+                ENGINE_ABORT("reason");
+
+            // Applying to the wrong base is refused
+            if (apply_delta_snapshot(delta, *base))
+                ENGINE_ABORT("reason");
+        }
+        if (seq == DELTA2_AT) {
+            write_delta_snapshot(delta2, *live, DELTA_AT, dirty);
+            dirty.clear();
+        }
+    }
+
+    delete log;   // final commit
+
+    // A newer snapshot cut short mid-write must be skipped
+    {
+        SnapshotHeader hdr{};
+        hdr.magic = SNAPSHOT_MAGIC;
+        hdr.version = SNAPSHOT_VERSION;
+        hdr.last_sequence = RECOVERY_EVENTS - 1;
+        hdr.state_size = sizeof(EngineState);
+
+        int fd = ::open(torn, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (fd < 0 || ::write(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr))
+            ENGINE_ABORT("reason");
+        ::close(fd);
+    }
+
+    auto* restored =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    RecoveryStats stats;
+    recover(RECOVERY_SNAPSHOT_DIR, RECOVERY_JOURNAL_DIR, *restored, stats);
+
+    if (stats.base_kind != SnapshotKind::LZ4 ||
+        stats.deltas_applied != 2 ||
+        stats.candidates_rejected != 1 ||
+        stats.snapshot_sequence != DELTA2_AT ||
+        stats.events_replayed != RECOVERY_EVENTS - DELTA2_AT) {
+        std::fprintf(stderr,
+            "recovery: base %d deltas %u rejected %u at %llu replayed %llu\n",
+            (int)stats.base_kind, stats.deltas_applied,
+            stats.candidates_rejected,
+            (unsigned long long)stats.snapshot_sequence,
+            (unsigned long long)stats.events_replayed);
+        ENGINE_ABORT("reason");
+    }
+
+    if (std::memcmp(live, restored, sizeof(EngineState)) != 0)
+        ENGINE_ABORT("reason");
+
+    // A digest rebuilt on the recovered state matches the running one
+    {
+        StateDigest recovered;
+        recovered.rebuild(*restored);
+        if (recovered.value(*restored) != digest.value(*live))
+            ENGINE_ABORT("reason");
+    }
+
+    // Logical encoding: size follows live data, not table capacity
+    struct stat st{};
+    if (::stat(raw, &st) != 0 ||
+        static_cast<uint64_t>(st.st_size) >= sizeof(EngineState) / 8)
+        ENGINE_ABORT("reason");
+
+    // Raw round trip of the older snapshot
+    zero_state(*restored);
+    read_snapshot(raw, *restored);
+    if (restored->last_sequence != RAW_AT)
+        ENGINE_ABORT("reason");
+
+    ::unlink(raw);
+    ::unlink(lz4);
+    ::unlink(delta);
+    ::unlink(delta2);
+    ::unlink(torn);
+
+    std::free(live);
+    std::free(base);
+    std::free(restored);
+}
+
+// ------------------------------------------------------------
+// A SPARSE book's trie survives full and delta snapshots byte for byte
+// ------------------------------------------------------------
+static void test_sparse_book() {
+    constexpr const char* FULL  = "test_sparse.snap";
+    constexpr const char* DELTA = "test_sparse.delta";
+    constexpr InstrumentSpec SPEC{
+        0, TICK_SIZE, 1'000'000, 1'000'000 + TRIE_KEYS * int64_t{TICK_SIZE},
+        false, LevelBackend::SPARSE};
+
+    auto* live = seeded_state();
+    init_instrument(*live, SPEC);
+    DirtyTracker dirty(*live);
+    MatchingEngine engine(*live, nullptr, &dirty);
+
+    std::mt19937_64 rng(1357);
+    uint64_t grc = 0;
+    uint64_t seq = 0;
+    EngineEvent ev;
+
+    // Spread prices over ~10M ticks so the trie branches out
+    auto step = [&] {
+        random_event(ev, ++seq, *live, rng, grc);
+        if (ev.header.type == EventType::NEW_ORDER)
+            ev.new_order.price += static_cast<int64_t>(rng() % 20) * 500'000;
+        engine.apply(ev);
+    };
+
+    while (seq < 5'000) step();
+
+    write_snapshot(FULL, *live);
+    dirty.clear();
+
+    while (seq < 8'000) step();
+    write_delta_snapshot(DELTA, *live, 5'000, dirty);
+
+    auto* restored =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    if (!load_snapshot(FULL, *restored) ||
+        !apply_delta_snapshot(DELTA, *restored) ||
+        std::memcmp(live, restored, sizeof(EngineState)) != 0)
+        ENGINE_ABORT("reason");
+
+    ::unlink(FULL);
+    ::unlink(DELTA);
+    std::free(live);
+    std::free(restored);
+}
+
+// ------------------------------------------------------------
+// An LZ4 image of several chunks, streamed through the compressor and
+// inflated chunk by chunk into the tables, with the sections (and the
+// trie) straddling chunk boundaries
+// ------------------------------------------------------------
+static void test_lz4_chunks() {
+    constexpr const char* PATH = "test_chunks.snap.lz4";
+    constexpr InstrumentSpec SPEC{
+        0, TICK_SIZE, 1'000'000, 1'000'000 + TRIE_KEYS * int64_t{TICK_SIZE},
+        false, LevelBackend::SPARSE};
+
+    auto* live = seeded_state();
+    init_instrument(*live, SPEC);
+    MatchingEngine engine(*live);
+
+    // Resting asks only, spread so the trie branches out
+    std::mt19937_64 rng(2468);
+    uint64_t seq = 0;
+    while (seq < 200'000) {
+        EngineEvent ev{};
+        ev.header.sequence = ++seq;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = rng() % 100;
+        ev.new_order.side       = SELL;
+        ev.new_order.price      =
+            1'000'000 + static_cast<int64_t>(rng() % 20'000) * 499;
+        ev.new_order.quantity   = 1;
+        engine.apply(ev);
+    }
+
+    if (state_image_size(*live) < 3 * size_t{SNAPSHOT_LZ4_CHUNK})
+        ENGINE_ABORT("reason");
+
+    auto* restored =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    const uint32_t thread_counts[] = {1, 3};
+    for (uint32_t threads : thread_counts) {
+        std::memset(restored, 0, sizeof(EngineState));
+        write_snapshot_lz4(PATH, *live, threads);
+        if (!load_snapshot_lz4(PATH, *restored, 4 - threads) ||
+            std::memcmp(live, restored, sizeof(EngineState)) != 0)
+            ENGINE_ABORT("reason");
+    }
+
+    ::unlink(PATH);
+    std::free(live);
+    std::free(restored);
+}
+
+// ------------------------------------------------------------
+// A raw snapshot with a flipped payload byte fails its CRC, and an image
+// whose handles point past their tables fails decode
+// ------------------------------------------------------------
+static void test_raw_integrity() {
+    constexpr const char* PATH = "test_integrity.snap";
+
+    auto* live = seeded_state();
+    MatchingEngine engine(*live);
+
+    std::mt19937_64 rng(9753);
+    uint64_t grc = 0;
+    uint64_t seq = 0;
+    EngineEvent ev;
+    while (seq < 5'000) {
+        random_event(ev, ++seq, *live, rng, grc);
+        engine.apply(ev);
+    }
+
+    auto* restored =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    write_snapshot(PATH, *live);
+    if (!load_snapshot(PATH, *restored) ||
+        std::memcmp(live, restored, sizeof(EngineState)) != 0)
+        ENGINE_ABORT("reason");
+
+    {
+        int fd = ::open(PATH, O_RDWR);
+        off_t at = static_cast<off_t>(sizeof(SnapshotHeader) +
+                                      sizeof(StateImageHeader) + 8);
+        uint8_t b = 0;
+        if (fd < 0 || ::pread(fd, &b, 1, at) != 1)
+            ENGINE_ABORT("reason");
+        b ^= 0x01;
+        if (::pwrite(fd, &b, 1, at) != 1)
+            ENGINE_ABORT("reason");
+        ::close(fd);
+
+        std::memset(restored, 0, sizeof(EngineState));
+        if (load_snapshot(PATH, *restored))
+            ENGINE_ABORT("reason");
+    }
+    ::unlink(PATH);
+
+    // Handle fields, patched one at a time in an otherwise valid image
+    const size_t len = state_image_size(*live);
+    auto* image = static_cast<uint8_t*>(std::malloc(len));
+    auto* patched = static_cast<uint8_t*>(std::malloc(len));
+    uint8_t* cursor = image;
+    encode_state_image(*live, [](const void* p, size_t n, void* ctx) {
+        uint8_t*& out = *static_cast<uint8_t**>(ctx);
+        std::memcpy(out, p, n);
+        out += n;
+    }, &cursor);
+
+    const uint32_t top = live->orders.slot_top;
+    const uint32_t live_end = live->accounts.live_end();
+    const uint32_t pool_top = live->book.level_pool_top;
+    const size_t cold = sizeof(StateImageHeader) +
+                        live_end * sizeof(AccountHot);
+    const size_t orders = cold + live_end * sizeof(AccountCold);
+    const size_t levels = len - pool_top * sizeof(PriceLevel);
+
+    struct Patch {
+        size_t   at;
+        uint32_t value;   // one past the end of the table it indexes
+    };
+    const Patch patches[] = {
+        {orders + 1 * sizeof(OrderHot) + offsetof(OrderHot, next), top},
+        {orders + (top - 1) * sizeof(OrderHot) + offsetof(OrderHot, prev),
+         top},
+        {orders + 2 * sizeof(OrderHot) + offsetof(OrderHot, account),
+         live_end},
+        {cold + offsetof(AccountCold, order_head), top},
+        {levels + sizeof(PriceLevel) + offsetof(PriceLevel, head), top},
+        {levels + sizeof(PriceLevel) + offsetof(PriceLevel, next_free),
+         pool_top},
+    };
+    for (const Patch& p : patches) {
+        std::memcpy(patched, image, len);
+        std::memcpy(patched + p.at, &p.value, sizeof(p.value));
+
+        std::memset(restored, 0, sizeof(EngineState));
+        if (decode_state_image(patched, len, *restored))
+            ENGINE_ABORT("reason");
+    }
+
+    std::free(image);
+    std::free(patched);
+    std::free(live);
+    std::free(restored);
+}
+
+// ------------------------------------------------------------
+// A writer resuming after a torn record clears the records behind it,
+// so a later reader does not run on into them past the new appends
+// ------------------------------------------------------------
+static void test_journal_resume() {
+    constexpr const char* DIR = "snapshot_test_resume.d";
+    constexpr uint64_t WRITTEN = 100;
+    constexpr uint64_t TORN = 50;   // record index
+
+    journal_remove_segments(DIR);
+    JournalConfig jcfg;
+    jcfg.dir = DIR;
+    jcfg.segment_records = 1024;
+
+    EngineEvent ev{};
+    ev.header.type = EventType::CANCEL;
+    {
+        JournalWriter w(jcfg);
+        for (uint64_t seq = 1; seq <= WRITTEN; ++seq) {
+            ev.header.sequence = seq;
+            w.append(ev);
+        }
+    }
+
+    // Tear one record in the middle; the ones after it stay valid
+    {
+        char path[320];
+        std::snprintf(path, sizeof(path), "%s/journal-%020llu.seg", DIR, 0ull);
+        int fd = ::open(path, O_RDWR);
+        off_t at = static_cast<off_t>(JOURNAL_HEADER_BYTES +
+                                      TORN * sizeof(JournalRecord) +
+                                      offsetof(JournalRecord, event));
+        uint8_t b = 0;
+        if (fd < 0 || ::pread(fd, &b, 1, at) != 1)
+            ENGINE_ABORT("reason");
+        b ^= 0xFF;
+        if (::pwrite(fd, &b, 1, at) != 1)
+            ENGINE_ABORT("reason");
+        ::close(fd);
+    }
+
+    {
+        JournalWriter w(jcfg);
+        if (w.last_sequence() != TORN)
+            ENGINE_ABORT("reason");
+        ev.header.sequence = TORN + 1;
+        w.append(ev);
+    }
+
+    JournalReader r(DIR);
+    uint64_t expect = 0;
+    while (const EngineEvent* e = r.next())
+        if (e->header.sequence != ++expect)
+            ENGINE_ABORT("reason");
+    if (expect != TORN + 1)
+        ENGINE_ABORT("reason");
+
+    journal_remove_segments(DIR);
+    ::rmdir(DIR);
+}
+
+// ------------------------------------------------------------
+// A crash between creating a segment and syncing its header leaves it
+// blank (empty, or pre-allocated zeros). Readers stop before it, and a
+// writer starts it over after the previous segment's last record.
+// ------------------------------------------------------------
+static void test_journal_blank_segment() {
+    constexpr const char* DIR = "snapshot_test_blank.d";
+    constexpr uint64_t RECORDS = 64;    // per segment
+    constexpr uint64_t WRITTEN = 2 * RECORDS;   // fills segments 0, 1
+    constexpr uint64_t MORE = 10;
+
+    JournalConfig jcfg;
+    jcfg.dir = DIR;
+    jcfg.segment_records = RECORDS;
+
+    auto read_all = [&](uint64_t expect_last) {
+        JournalReader r(DIR);
+        uint64_t seq = 0;
+        while (const EngineEvent* e = r.next())
+            if (e->header.sequence != ++seq)
+                ENGINE_ABORT("reason");
+        if (seq != expect_last)
+            ENGINE_ABORT("reason");
+    };
+
+    const off_t blank_sizes[] = {
+        0, static_cast<off_t>(JOURNAL_HEADER_BYTES +
+                              RECORDS * sizeof(JournalRecord))};
+    for (off_t blank : blank_sizes) {
+        journal_remove_segments(DIR);
+
+        EngineEvent ev{};
+        ev.header.type = EventType::CANCEL;
+        {
+            JournalWriter w(jcfg);
+            for (uint64_t seq = 1; seq <= WRITTEN; ++seq) {
+                ev.header.sequence = seq;
+                w.append(ev);
+            }
+        }
+
+        // Segment 2 as a crash after fallocate() left it
+        char path[320];
+        std::snprintf(path, sizeof(path), "%s/journal-%020llu.seg", DIR, 2ull);
+        int fd = ::open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (fd < 0 || ::ftruncate(fd, blank) != 0)
+            ENGINE_ABORT("reason");
+        ::close(fd);
+
+        read_all(WRITTEN);
+
+        {
+            JournalWriter w(jcfg);
+            if (w.last_sequence() != WRITTEN)
+                ENGINE_ABORT("reason");
+            for (uint64_t seq = WRITTEN + 1; seq <= WRITTEN + MORE; ++seq) {
+                ev.header.sequence = seq;
+                w.append(ev);
+            }
+        }
+
+        read_all(WRITTEN + MORE);
+    }
+
+    journal_remove_segments(DIR);
+    ::rmdir(DIR);
+}
+
+// ------------------------------------------------------------
+// A forked snapshot holds the state as of start(), whatever the
+// parent applies while it is being written
+// ------------------------------------------------------------
+static void test_background() {
+    constexpr const char* PATH = "test_background.snap";
+
+    auto* live = seeded_state();
+    auto* frozen =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    auto* restored =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    MatchingEngine engine(*live);
+
+    std::mt19937_64 rng(4242);
+    uint64_t grc = 0;
+    uint64_t seq = 0;
+    EngineEvent ev;
+
+    // The LZ4 child writes single-threaded
+    const SnapshotFormat formats[] = {SnapshotFormat::RAW,
+                                      SnapshotFormat::LZ4};
+    for (SnapshotFormat format : formats) {
+        for (uint64_t end = seq + 5'000; seq < end;) {
+            random_event(ev, ++seq, *live, rng, grc);
+            engine.apply(ev);
+        }
+
+        std::memcpy(frozen, live, sizeof(EngineState));
+
+        BackgroundSnapshot bg;
+        if (!bg.start(PATH, *live, format) || bg.sequence() != seq)
+            ENGINE_ABORT("reason");
+
+        // Keep matching while the child writes
+        for (uint64_t end = seq + 5'000; seq < end;) {
+            random_event(ev, ++seq, *live, rng, grc);
+            engine.apply(ev);
+        }
+
+        if (!bg.wait())
+            ENGINE_ABORT("reason");
+
+        std::memset(restored, 0, sizeof(EngineState));
+        bool loaded = format == SnapshotFormat::LZ4
+                          ? load_snapshot_lz4(PATH, *restored)
+                          : load_snapshot(PATH, *restored);
+        if (!loaded ||
+            std::memcmp(frozen, restored, sizeof(EngineState)) != 0)
+            ENGINE_ABORT("reason");
+    }
+
+    ::unlink(PATH);
+    std::free(live);
+    std::free(frozen);
+    std::free(restored);
+}
 
 int main() {
     // -----------------------
@@ -14,8 +590,9 @@ int main() {
 
     // Seed balances
     for (uint64_t i = 0; i < 100; ++i) {
-        state->accounts[i].base.available  = 1'000'000;
-        state->accounts[i].quote.available = 1'000'000;
+        uint32_t slot = state->accounts.open(i);
+        state->accounts.hot[slot].base_available  = 1'000'000;
+        state->accounts.hot[slot].quote_available = 1'000'000;
     }
 
     write_snapshot_lz4("test.snap", *state);
@@ -27,7 +604,51 @@ int main() {
     if (std::memcmp(state, restored, sizeof(EngineState)) != 0)
         ENGINE_ABORT("reason");
 
+    // A flipped payload byte fails its chunk CRC
+    {
+        int fd = ::open("test.snap", O_RDWR);
+        off_t end = ::lseek(fd, -1, SEEK_END);
+        uint8_t b = 0;
+        if (fd < 0 || end < 0 || ::pread(fd, &b, 1, end) != 1)
+            ENGINE_ABORT("reason");
+        b ^= 0xFF;
+        if (::pwrite(fd, &b, 1, end) != 1)
+            ENGINE_ABORT("reason");
+        ::close(fd);
+
+        if (load_snapshot_lz4("test.snap", *restored))
+            ENGINE_ABORT("reason");
+    }
+
     delete state;
     delete restored;
+
+    // A runtime-configured band survives the logical image
+    {
+        constexpr InstrumentSpec SPEC{7, 5, 2'000'000, 2'000'000 + 400 * 5,
+                                      true, LevelBackend::DENSE};
+        auto* a = static_cast<EngineState*>(
+            std::calloc(1, sizeof(EngineState)));
+        auto* b = static_cast<EngineState*>(
+            std::calloc(1, sizeof(EngineState)));
+        init_instrument(*a, SPEC);
+
+        write_snapshot("test_band.snap", *a);
+        if (!load_snapshot("test_band.snap", *b) ||
+            std::memcmp(a, b, sizeof(EngineState)) != 0)
+            ENGINE_ABORT("reason");
+
+        ::unlink("test_band.snap");
+        std::free(a);
+        std::free(b);
+    }
+
+    test_recovery();
+    test_sparse_book();
+    test_lz4_chunks();
+    test_raw_integrity();
+    test_journal_resume();
+    test_journal_blank_segment();
+    test_background();
     return 0;
-}
\ No newline at end of file
+}
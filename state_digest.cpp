@@ -0,0 +1,234 @@
+#include "state_digest.h"
+#include "engine_common.h"
+#include <cstdlib>   // calloc, free
+
+static void die(const char*) {
+    ENGINE_ABORT("state digest");
+}
+
+// =======================
+// Row Hashes
+// =======================
+
+// Row kinds, so equal rows of different tables do not cancel
+constexpr uint64_t DIGEST_ORDER   = 1ull << 56;
+constexpr uint64_t DIGEST_ACCOUNT = 2ull << 56;
+constexpr uint64_t DIGEST_LEVEL   = 3ull << 56;
+constexpr uint64_t DIGEST_SCALARS = 4ull << 56;
+
+// Fold one word in, then a full avalanche (splitmix64 finalizer) at the end
+struct RowHash {
+    uint64_t h;
+
+    explicit RowHash(uint64_t key) : h(key * 0x9E3779B97F4A7C15ull) {}
+
+    inline RowHash& add(uint64_t v) {
+        h = (h ^ v) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+        return *this;
+    }
+
+    inline RowHash& add_balance(Balance v) {
+        add(static_cast<uint64_t>(v));
+        if constexpr (sizeof(Balance) > sizeof(uint64_t))
+            add(static_cast<uint64_t>(v >> 64));
+        return *this;
+    }
+
+    inline uint64_t done() const {
+        uint64_t z = h;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+// The fields Orders::logical_equals compares
+static uint64_t order_hash(const Orders& o, uint32_t oid) {
+    const OrderHot& h = o.hot[oid];
+    const OrderCold& c = o.cold[oid];
+    return RowHash(DIGEST_ORDER | oid)
+        .add(static_cast<uint64_t>(h.qty_remaining))
+        .add(h.account | uint64_t{h.prev} << 32)
+        .add(h.next | uint64_t{h.acct_prev} << 32)
+        .add(h.acct_next | uint64_t{static_cast<uint8_t>(h.side)} << 32 |
+             uint64_t{static_cast<uint8_t>(h.state)} << 40)
+        .add(c.id)
+        .add(static_cast<uint64_t>(c.price))
+        .add(c.accepted_seq)
+        .add_balance(c.quote_reserved)
+        .done();
+}
+
+// The fields Accounts::logical_equals compares
+static uint64_t account_hash(const Accounts& a, uint32_t slot) {
+    const AccountHot& h = a.hot[slot];
+    const AccountCold& c = a.cold[slot];
+    return RowHash(DIGEST_ACCOUNT | slot)
+        .add_balance(h.base_available)
+        .add_balance(h.quote_available)
+        .add_balance(c.base_locked)
+        .add_balance(c.quote_locked)
+        .add(c.external_id)
+        .add(c.order_head | uint64_t{c.order_tail} << 32)
+        .add(static_cast<uint8_t>(h.state))
+        .done();
+}
+
+// A free level contributes nothing; next_free is pool bookkeeping. The
+// level's place in the book goes in too: side and price come from its
+// head order (a level holds one side at one price), and the book must
+// map that (side, index) to this handle. Price rather than index, so a
+// band recenter, which renumbers every level, leaves the hash alone.
+static uint64_t level_hash(const EngineState& s, uint32_t h) {
+    const OrderBook& b = s.book;
+    const PriceLevel& l = b.level_pool[h];
+    if (l.count == 0) return 0;
+
+    const uint8_t side = static_cast<uint8_t>(s.orders.hot[l.head].side);
+    const int64_t price = s.orders.cold[l.head].price;
+    const int32_t idx = b.price_to_index(price);
+    const bool placed = b.indexable(price) && b.handle(side, idx) == h;
+
+    return RowHash(DIGEST_LEVEL | h)
+        .add(l.head | uint64_t{l.tail} << 32)
+        .add(l.count)
+        .add(static_cast<uint64_t>(l.quantity))
+        .add(side | uint64_t{placed} << 8)
+        .add(static_cast<uint64_t>(price))
+        .done();
+}
+
+// =======================
+// Digest
+// =======================
+
+void StateDigest::Rows::init(uint32_t rows) {
+    hash = static_cast<uint64_t*>(std::calloc(rows, sizeof(uint64_t)));
+    touched_bits = static_cast<uint64_t*>(
+        std::calloc((rows + 63) / 64, sizeof(uint64_t)));
+    touched = static_cast<uint32_t*>(std::calloc(rows, sizeof(uint32_t)));
+    if (!hash || !touched_bits || !touched) die("calloc");
+    touched_count = 0;
+}
+
+void StateDigest::Rows::release() {
+    std::free(hash);
+    std::free(touched_bits);
+    std::free(touched);
+}
+
+StateDigest::StateDigest() {
+    orders_.init(MAX_ORDERS);
+    accounts_.init(MAX_ACCOUNTS);
+    levels_.init(LEVEL_POOL_SIZE);
+}
+
+StateDigest::~StateDigest() {
+    orders_.release();
+    accounts_.release();
+    levels_.release();
+}
+
+void StateDigest::rebuild(const EngineState& s) {
+    rows_ = 0;
+
+    // Drop anything touched but not folded; every row is rehashed below
+    Rows* tables[] = {&orders_, &accounts_, &levels_};
+    for (Rows* r : tables) {
+        for (uint32_t i = 0; i < r->touched_count; ++i)
+            r->touched_bits[r->touched[i] >> 6] = 0;
+        r->touched_count = 0;
+    }
+
+    for (uint32_t oid = 0; oid < MAX_ORDERS; ++oid) {
+        orders_.hash[oid] =
+            (oid != 0 && oid < s.orders.slot_top) ? order_hash(s.orders, oid)
+                                                   : 0;
+        rows_ ^= orders_.hash[oid];
+    }
+
+    for (uint32_t slot = 0; slot < MAX_ACCOUNTS; ++slot) {
+        accounts_.hash[slot] = (slot < s.accounts.live_end())
+                                   ? account_hash(s.accounts, slot)
+                                   : 0;
+        rows_ ^= accounts_.hash[slot];
+    }
+
+    for (uint32_t h = 0; h < LEVEL_POOL_SIZE; ++h) {
+        levels_.hash[h] = (h != 0 && h < s.book.level_pool_top)
+                              ? level_hash(s, h)
+                              : 0;
+        rows_ ^= levels_.hash[h];
+    }
+}
+
+void StateDigest::fold(const EngineState& s) {
+    for (uint32_t i = 0; i < orders_.touched_count; ++i) {
+        uint32_t oid = orders_.touched[i];
+        orders_.touched_bits[oid >> 6] = 0;
+        if (oid == 0) continue;
+
+        uint64_t h = order_hash(s.orders, oid);
+        rows_ ^= orders_.hash[oid] ^ h;
+        orders_.hash[oid] = h;
+    }
+    orders_.touched_count = 0;
+
+    for (uint32_t i = 0; i < accounts_.touched_count; ++i) {
+        uint32_t slot = accounts_.touched[i];
+        accounts_.touched_bits[slot >> 6] = 0;
+
+        uint64_t h = account_hash(s.accounts, slot);
+        rows_ ^= accounts_.hash[slot] ^ h;
+        accounts_.hash[slot] = h;
+    }
+    accounts_.touched_count = 0;
+
+    for (uint32_t i = 0; i < levels_.touched_count; ++i) {
+        uint32_t lh = levels_.touched[i];
+        levels_.touched_bits[lh >> 6] = 0;
+        if (lh == 0) continue;
+
+        uint64_t h = level_hash(s, lh);
+        rows_ ^= levels_.hash[lh] ^ h;
+        levels_.hash[lh] = h;
+    }
+    levels_.touched_count = 0;
+}
+
+uint64_t StateDigest::value(const EngineState& s) const {
+    const OrderBook& b = s.book;
+    return rows_ ^
+           RowHash(DIGEST_SCALARS)
+               .add(s.last_sequence)
+               .add(s.last_grc_sequence)
+               .add(s.instrument)
+               .add(s.orders.slot_top | uint64_t{s.orders.free_head} << 32)
+               .add(s.accounts.count)
+               .add(static_cast<uint32_t>(b.best_bid) |
+                    uint64_t{static_cast<uint32_t>(b.best_ask)} << 32)
+               .add(static_cast<uint64_t>(b.min_price))
+               .add(static_cast<uint64_t>(b.tick_size))
+               .add(static_cast<uint32_t>(b.ticks) |
+                    uint64_t{static_cast<uint8_t>(b.backend)} << 32)
+               .done();
+}
+
+// =======================
+// Full Comparison
+// =======================
+
+const char* state_difference(const EngineState& a, const EngineState& b) {
+    if (a.last_sequence != b.last_sequence ||
+        a.last_grc_sequence != b.last_grc_sequence ||
+        a.instrument != b.instrument)
+        return "sequence";
+    if (!a.orders.logical_equals(b.orders))
+        return "orders";
+    if (!a.accounts.logical_equals(b.accounts))
+        return "accounts";
+    if (!a.book.logical_equals(b.book))
+        return "book";
+    return nullptr;
+}
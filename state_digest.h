@@ -0,0 +1,84 @@
+#pragma once
+#include "engine_state.h"
+#include <cstdint>
+
+// =======================
+// Rolling State Digest
+// =======================
+//
+// A 64-bit digest of the logical state that MatchingEngine keeps up to
+// date as it applies events, so two instances fed the same stream
+// (primary, shadow, replay) can compare one value every N events and
+// fall back to the full table walks only when the values differ.
+//
+// The value is the XOR of one hash per row (order slot, account slot,
+// level pool slot), each keyed by its row number, plus a hash of the
+// scalars taken when value() is read. The engine reports every row it
+// writes through its dirty-marking hooks; at the end of each apply() or
+// apply_batch() the touched rows are rehashed and their old hashes XORed
+// out. The cost is the rows touched, each hashed once per call however
+// often the call touched it.
+//
+// Rows past their table's top are zero and left out, so a digest
+// rebuilt from a restored snapshot equals the running one of the
+// instance that wrote it. Only what logical_equals compares goes in: a
+// level's hash is zero while it is free, and covers the side and price
+// the book files it under as well as its contents.
+
+class StateDigest {
+public:
+    StateDigest();
+    ~StateDigest();
+
+    StateDigest(const StateDigest&) = delete;
+    StateDigest& operator=(const StateDigest&) = delete;
+
+    // Full recompute, O(order slots + accounts + levels). MatchingEngine
+    // calls it on attach; call it again after writing the state outside
+    // the engine (seeding balances, restoring a snapshot).
+    void rebuild(const EngineState& state);
+
+    // Digest of `state`, which must be the state the engine maintains
+    // this digest for, between apply() / apply_batch() calls
+    uint64_t value(const EngineState& state) const;
+
+    // ---- engine side ----
+    inline void touch_order(uint32_t oid)   { orders_.touch(oid); }
+    inline void touch_account(uint32_t s)   { accounts_.touch(s); }
+    inline void touch_level(uint32_t h)     { levels_.touch(h); }
+
+    // Rehash what was touched since the last fold
+    void fold(const EngineState& state);
+
+private:
+    // Last folded hash of each row, and the rows touched since
+    struct Rows {
+        uint64_t* hash = nullptr;
+        uint64_t* touched_bits = nullptr;
+        uint32_t* touched = nullptr;
+        uint32_t  touched_count = 0;
+
+        void init(uint32_t rows);
+        void release();
+
+        // The row's old hash is needed at fold time: start loading it
+        inline void touch(uint32_t row) {
+            uint64_t bit = 1ull << (row & 63);
+            if (touched_bits[row >> 6] & bit) return;
+            touched_bits[row >> 6] |= bit;
+            touched[touched_count++] = row;
+            __builtin_prefetch(&hash[row]);
+        }
+    };
+
+    Rows orders_;
+    Rows accounts_;
+    Rows levels_;
+
+    uint64_t rows_ = 0;   // XOR of every row hash
+};
+
+// Which part of the state differs ("orders", "accounts", "book",
+// "sequence"), or nullptr when the two are logically equal. The full
+// walk behind a digest mismatch.
+const char* state_difference(const EngineState& a, const EngineState& b);
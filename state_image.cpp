@@ -0,0 +1,355 @@
+#include "state_image.h"
+#include "engine_common.h"
+
+#include <cstdlib>   // calloc, free
+#include <cstring>   // memcpy
+
+static void die(const char*) {
+    ENGINE_ABORT("state image");
+}
+
+constexpr uint32_t LEVEL_SIDE_BIT = 1u << 31;
+
+static uint32_t count_levels(const LevelBitmap<MAX_TICKS>& bits) {
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < LevelBitmap<MAX_TICKS>::L0_WORDS; ++w)
+        n += static_cast<uint32_t>(__builtin_popcountll(bits.l0[w]));
+    return n;
+}
+
+static uint32_t count_levels(const OrderBook& b) {
+    if (b.backend == LevelBackend::DENSE)
+        return count_levels(b.buy_bits) + count_levels(b.sell_bits);
+
+    uint32_t n = 0;
+    for (uint8_t side = BUY; side <= SELL; ++side)
+        for (int32_t i = b.next_level(side, 0); i != -1;
+             i = b.next_level(side, i + 1))
+            ++n;
+    return n;
+}
+
+static bool sparse(const StateImageHeader& h) {
+    return h.backend == static_cast<uint32_t>(LevelBackend::SPARSE);
+}
+
+static size_t orders_bytes(size_t n) {
+    return n * (sizeof(OrderHot) + sizeof(OrderCold));
+}
+
+static size_t image_size(const StateImageHeader& h) {
+    return sizeof(StateImageHeader) +
+           size_t(h.account_count + 1) * (sizeof(AccountHot) + sizeof(AccountCold)) +
+           orders_bytes(h.order_slot_top) +
+           size_t(h.level_count) * sizeof(StateImageLevel) +
+           size_t(h.level_pool_top) * sizeof(PriceLevel) +
+           (sparse(h) ? size_t(h.trie_node_top) * sizeof(TrieNode) : 0);
+}
+
+static StateImageHeader make_header(const EngineState& s) {
+    StateImageHeader h{};
+    h.last_sequence     = s.last_sequence;
+    h.last_grc_sequence = s.last_grc_sequence;
+    h.order_slot_top    = s.orders.slot_top;
+    h.order_free_head   = s.orders.free_head;
+    h.instrument        = s.instrument;
+    h.account_count     = s.accounts.count;
+    h.level_count       = count_levels(s.book);
+    h.level_pool_top    = s.book.level_pool_top;
+    h.level_free_head   = s.book.level_free_head;
+    h.best_bid          = s.book.best_bid;
+    h.best_ask          = s.book.best_ask;
+    h.min_price         = s.book.min_price;
+    h.max_price         = s.book.max_price;
+    h.tick_size         = s.book.tick_size;
+    h.ticks             = s.book.ticks;
+    h.auto_recenter     = s.book.auto_recenter;
+    h.backend           = static_cast<uint32_t>(s.book.backend);
+    h.trie_node_top     = s.book.trie.node_top;
+    h.trie_free_head    = s.book.trie.node_free_head;
+    h.trie_node_live    = s.book.trie.node_live;
+    h.trie_root[0]      = s.book.trie.root[0];
+    h.trie_root[1]      = s.book.trie.root[1];
+    h.balance_bits      = ENGINE_BALANCE_BITS;
+    return h;
+}
+
+size_t state_image_size(const EngineState& state) {
+    return image_size(make_header(state));
+}
+
+// =======================
+// Encode
+// =======================
+
+void encode_state_image(const EngineState& s,
+                        StateImageSink sink,
+                        void* ctx) {
+    StateImageHeader h = make_header(s);
+    sink(&h, sizeof(h), ctx);
+
+    const Accounts& a = s.accounts;
+    sink(a.hot,  a.live_end() * sizeof(AccountHot),  ctx);
+    sink(a.cold, a.live_end() * sizeof(AccountCold), ctx);
+
+    const Orders& o = s.orders;
+    const size_t n = o.slot_top;
+    sink(o.hot,  n * sizeof(OrderHot),  ctx);
+    sink(o.cold, n * sizeof(OrderCold), ctx);
+
+    // Occupied levels, found through the bitmaps / trie, in small batches
+    const OrderBook& b = s.book;
+    StateImageLevel batch[512];
+    uint32_t used = 0;
+
+    for (uint8_t side = BUY; side <= SELL; ++side) {
+        for (int32_t idx = b.next_level(side, 0); idx != -1;
+             idx = b.next_level(side, idx + 1)) {
+            batch[used].key = static_cast<uint32_t>(idx) |
+                              (side == SELL ? LEVEL_SIDE_BIT : 0);
+            batch[used].handle = b.handle(side, idx);
+
+            if (++used == 512) {
+                sink(batch, sizeof(batch), ctx);
+                used = 0;
+            }
+        }
+    }
+    if (used) sink(batch, used * sizeof(StateImageLevel), ctx);
+
+    sink(b.level_pool, size_t(b.level_pool_top) * sizeof(PriceLevel), ctx);
+
+    if (b.backend == LevelBackend::SPARSE)
+        sink(b.trie.nodes, size_t(b.trie.node_top) * sizeof(TrieNode), ctx);
+}
+
+// =======================
+// Decode
+// =======================
+
+// Every handle the engine will follow stays inside its table, so a
+// corrupt image fails here rather than indexing past slot_top later
+static bool handles_in_range(const StateImageHeader& h,
+                             const EngineState& s) {
+    const uint32_t orders = h.order_slot_top ? h.order_slot_top : 1;
+    const uint32_t levels = h.level_pool_top ? h.level_pool_top : 1;
+
+    for (uint32_t oid = 1; oid < h.order_slot_top; ++oid) {
+        const OrderHot& o = s.orders.hot[oid];
+        if (o.next >= orders || o.prev >= orders ||
+            o.acct_next >= orders || o.acct_prev >= orders ||
+            o.account > h.account_count)
+            return false;
+    }
+
+    for (uint32_t slot = 0; slot <= h.account_count; ++slot) {
+        const AccountCold& c = s.accounts.cold[slot];
+        if (c.order_head >= orders || c.order_tail >= orders)
+            return false;
+    }
+
+    for (uint32_t lh = 1; lh < h.level_pool_top; ++lh) {
+        const PriceLevel& l = s.book.level_pool[lh];
+        if (l.head >= orders || l.tail >= orders || l.next_free >= levels)
+            return false;
+    }
+    return true;
+}
+
+// Inner children are node handles and leaves level handles. A tree
+// visits each node once, so more visits than nodes means a cycle.
+static bool trie_in_range(const StateImageHeader& h, const LevelTrie& t,
+                          uint32_t node, uint32_t depth, uint32_t& visits) {
+    if (++visits > h.trie_node_top) return false;
+
+    const TrieNode& n = t.nodes[node];
+    for (uint64_t m = n.mask; m; m &= m - 1) {
+        uint32_t child = n.child[__builtin_ctzll(m)];
+        if (depth + 1 == TRIE_DEPTH) {
+            if (child == 0 || child >= h.level_pool_top) return false;
+        } else if (child == 0 || child >= h.trie_node_top ||
+                   !trie_in_range(h, t, child, depth + 1, visits)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool trie_in_range(const StateImageHeader& h, const LevelTrie& t) {
+    // Free nodes keep only the free-list link
+    for (uint32_t i = 1; i < h.trie_node_top; ++i)
+        if (t.nodes[i].mask == 0 && t.nodes[i].child[0] >= h.trie_node_top)
+            return false;
+
+    uint32_t visits = 0;
+    return trie_in_range(h, t, h.trie_root[0], 0, visits) &&
+           trie_in_range(h, t, h.trie_root[1], 0, visits);
+}
+
+StateImageDecoder::~StateImageDecoder() {
+    std::free(levels_);
+}
+
+void StateImageDecoder::add_section(void* dst, uint64_t len) {
+    uint64_t offset = section_count_
+        ? sections_[section_count_ - 1].offset +
+              sections_[section_count_ - 1].len
+        : 0;
+    sections_[section_count_++] = {offset, len, static_cast<uint8_t*>(dst)};
+}
+
+bool StateImageDecoder::begin(const uint8_t* header, size_t len) {
+    if (len < sizeof(StateImageHeader)) return false;
+
+    StateImageHeader& h = h_;
+    std::memcpy(&h, header, sizeof(h));
+
+    if (h.balance_bits != ENGINE_BALANCE_BITS ||
+        h.account_count >= MAX_ACCOUNTS ||
+        h.order_slot_top > MAX_ORDERS ||
+        h.order_free_head >= (h.order_slot_top ? h.order_slot_top : 1) ||
+        h.level_count >= LEVEL_POOL_SIZE ||
+        h.backend > static_cast<uint32_t>(LevelBackend::SPARSE) ||
+        h.tick_size <= 0 || h.ticks <= 0 ||
+        h.ticks > band_capacity(static_cast<LevelBackend>(h.backend)) ||
+        (sparse(h) && (h.trie_node_top > TRIE_NODES ||
+                       h.trie_root[0] == 0 || h.trie_root[1] == 0 ||
+                       h.trie_root[0] >= h.trie_node_top ||
+                       h.trie_root[1] >= h.trie_node_top ||
+                       h.trie_free_head >= h.trie_node_top)) ||
+        h.level_pool_top > LEVEL_POOL_SIZE ||
+        h.level_free_head >= (h.level_pool_top ? h.level_pool_top : 1) ||
+        image_size(h) != len)
+        return false;
+
+    // Level entries go in once the trie they must agree with is loaded
+    if (h.level_count) {
+        levels_ = static_cast<uint8_t*>(
+            std::calloc(h.level_count, sizeof(StateImageLevel)));
+        if (!levels_) die("calloc");
+    }
+
+    Accounts& a = s_.accounts;
+    Orders& o = s_.orders;
+    OrderBook& b = s_.book;
+    const uint64_t accounts = uint64_t(h.account_count) + 1;
+    const uint64_t orders = h.order_slot_top;
+
+    add_section(nullptr, sizeof(h));
+    add_section(a.hot,  accounts * sizeof(AccountHot));
+    add_section(a.cold, accounts * sizeof(AccountCold));
+    add_section(o.hot,  orders * sizeof(OrderHot));
+    add_section(o.cold, orders * sizeof(OrderCold));
+    add_section(levels_, uint64_t(h.level_count) * sizeof(StateImageLevel));
+    add_section(b.level_pool, uint64_t(h.level_pool_top) * sizeof(PriceLevel));
+    if (sparse(h))
+        add_section(b.trie.nodes,
+                    uint64_t(h.trie_node_top) * sizeof(TrieNode));
+
+    len_ = len;
+    return true;
+}
+
+uint8_t* StateImageDecoder::target(uint64_t offset, size_t n) const {
+    for (uint32_t i = 0; i < section_count_; ++i) {
+        const Section& sec = sections_[i];
+        if (offset >= sec.offset && offset + n <= sec.offset + sec.len)
+            return sec.dst ? sec.dst + (offset - sec.offset) : nullptr;
+    }
+    return nullptr;
+}
+
+void StateImageDecoder::place(uint64_t offset, const uint8_t* data,
+                              size_t n) {
+    if (offset + n > len_) die("image piece out of range");
+
+    for (uint32_t i = 0; i < section_count_; ++i) {
+        const Section& sec = sections_[i];
+        uint64_t lo = offset > sec.offset ? offset : sec.offset;
+        uint64_t hi = offset + n < sec.offset + sec.len
+                          ? offset + n : sec.offset + sec.len;
+        if (lo >= hi || !sec.dst) continue;
+        std::memcpy(sec.dst + (lo - sec.offset), data + (lo - offset),
+                    hi - lo);
+    }
+}
+
+bool StateImageDecoder::finish() {
+    const StateImageHeader& h = h_;
+    EngineState& s = s_;
+
+    if (!handles_in_range(h, s) ||
+        (sparse(h) && !trie_in_range(h, s.book.trie)))
+        return false;
+
+    s.last_sequence     = h.last_sequence;
+    s.last_grc_sequence = h.last_grc_sequence;
+    s.instrument        = h.instrument;
+
+    Accounts& a = s.accounts;
+    a.count = h.account_count;
+    a.reindex();
+
+    Orders& o = s.orders;
+    o.slot_top  = h.order_slot_top;
+    o.free_head = h.order_free_head;
+
+    OrderBook& b = s.book;
+    b.backend = static_cast<LevelBackend>(h.backend);
+
+    if (sparse(h)) {
+        b.trie.node_top       = h.trie_node_top;
+        b.trie.node_free_head = h.trie_free_head;
+        b.trie.node_live      = h.trie_node_live;
+        b.trie.root[0]        = h.trie_root[0];
+        b.trie.root[1]        = h.trie_root[1];
+    }
+
+    for (uint32_t i = 0; i < h.level_count; ++i) {
+        StateImageLevel l;
+        std::memcpy(&l, levels_ + i * sizeof(l), sizeof(l));
+
+        uint32_t idx = l.key & ~LEVEL_SIDE_BIT;
+        uint8_t side = (l.key & LEVEL_SIDE_BIT) ? SELL : BUY;
+        if (idx >= static_cast<uint32_t>(h.ticks) ||
+            l.handle == 0 || l.handle >= h.level_pool_top)
+            return false;
+
+        if (sparse(h)) {
+            if (b.trie.get(side, static_cast<int32_t>(idx)) != l.handle)
+                return false;
+        } else if (side == SELL) {
+            b.sell_levels[idx] = l.handle;
+            b.sell_bits.set(static_cast<int32_t>(idx));
+        } else {
+            b.buy_levels[idx] = l.handle;
+            b.buy_bits.set(static_cast<int32_t>(idx));
+        }
+    }
+
+    if (h.best_bid < -1 || h.best_bid >= h.ticks ||
+        h.best_ask < -1 || h.best_ask >= h.ticks)
+        return false;
+
+    b.level_pool_top  = h.level_pool_top;
+    b.level_free_head = h.level_free_head;
+    b.best_bid        = h.best_bid;
+    b.best_ask        = h.best_ask;
+    b.best_bid_level  = (h.best_bid == -1) ? 0 : b.handle(BUY, h.best_bid);
+    b.best_ask_level  = (h.best_ask == -1) ? 0 : b.handle(SELL, h.best_ask);
+    b.min_price       = h.min_price;
+    b.max_price       = h.max_price;
+    b.tick_size       = h.tick_size;
+    b.ticks           = h.ticks;
+    b.auto_recenter   = h.auto_recenter ? 1 : 0;
+    return true;
+}
+
+bool decode_state_image(const uint8_t* image,
+                        size_t len,
+                        EngineState& state) {
+    StateImageDecoder decoder(state);
+    if (!decoder.begin(image, len)) return false;
+    decoder.place(0, image, len);
+    return decoder.finish();
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "engine_state.h"
+#include <cstddef>
+#include <cstdint>
+
+// =======================
+// Logical State Image
+// =======================
+//
+// What a snapshot stores instead of the raw EngineState bytes:
+//
+//   [StateImageHeader]
+//   AccountHot  [0, account_count]      AccountCold [0, account_count]
+//   OrderHot    [0, order_slot_top)     OrderCold   [0, order_slot_top)
+//   [StateImageLevel] * level_count     (non-zero level handles)
+//   PriceLevel  [0, level_pool_top)
+//   TrieNode    [0, trie_node_top)      (SPARSE books only)
+//
+// Everything past those bounds is zero in a live state, and the level
+// bitmaps and account index are derived data, so the image scales with
+// live orders / accounts / levels rather than the table capacities.
+// A sparse book's trie is copied as-is rather than rebuilt, so node
+// handles (and so delta snapshots taken against it) stay valid.
+// Handles are indices, so restore needs no pointer fix-up; it copies the
+// sections back and rebuilds the bitmaps and the index.
+
+struct StateImageHeader {
+    uint64_t last_sequence;
+    uint64_t last_grc_sequence;
+    uint32_t order_slot_top;
+    uint32_t order_free_head;
+    uint32_t instrument;
+    uint32_t account_count;
+    uint32_t level_count;
+    uint32_t level_pool_top;
+    uint32_t level_free_head;
+    int32_t  best_bid;
+    int32_t  best_ask;
+    int64_t  min_price;
+    int64_t  max_price;
+    int64_t  tick_size;
+    int32_t  ticks;
+    uint32_t auto_recenter;
+    uint32_t backend;
+    uint32_t trie_node_top;
+    uint32_t trie_free_head;
+    uint32_t trie_node_live;
+    uint32_t trie_root[2];
+    uint32_t balance_bits;   // ENGINE_BALANCE_BITS of the writer
+};
+
+struct StateImageLevel {
+    uint32_t key;        // price index | side << 31
+    uint32_t handle;
+};
+
+// Receives the image in order, mostly as views straight into the state
+using StateImageSink = void (*)(const void* data, size_t len, void* ctx);
+
+size_t state_image_size(const EngineState& state);
+
+void encode_state_image(const EngineState& state,
+                        StateImageSink sink,
+                        void* ctx);
+
+// `state` must be zeroed. False (state undefined) on a malformed image.
+bool decode_state_image(const uint8_t* image,
+                        size_t len,
+                        EngineState& state);
+
+// Restores an image that arrives in pieces, in any order, so a reader
+// never holds all of it: begin() takes the header, place() copies each
+// piece straight into its table (from several threads at once, for
+// disjoint pieces) and finish() rebuilds the derived data. Bytes never
+// placed stay zero, as in the zeroed target. The level handle list is
+// the only thing buffered, and it is at most LEVEL_POOL_SIZE entries.
+class StateImageDecoder {
+public:
+    // `state` must be zeroed
+    explicit StateImageDecoder(EngineState& state) : s_(state) {}
+    ~StateImageDecoder();
+
+    StateImageDecoder(const StateImageDecoder&) = delete;
+    StateImageDecoder& operator=(const StateImageDecoder&) = delete;
+
+    // `header` is the image's first sizeof(StateImageHeader) bytes; false
+    // unless it describes a well-formed image of `len` bytes
+    bool begin(const uint8_t* header, size_t len);
+
+    // Where image bytes [offset, offset + n) land when they fall inside
+    // one table, else nullptr; a reader can inflate them there directly
+    uint8_t* target(uint64_t offset, size_t n) const;
+
+    // Copy image bytes [offset, offset + n) into place
+    void place(uint64_t offset, const uint8_t* data, size_t n);
+
+    // False (state undefined) when the placed image is inconsistent
+    bool finish();
+
+private:
+    struct Section {
+        uint64_t offset;   // in the image
+        uint64_t len;
+        uint8_t* dst;      // nullptr: the header, already consumed
+    };
+
+    EngineState&     s_;
+    StateImageHeader h_{};
+    Section          sections_[8] = {};
+    uint32_t         section_count_ = 0;
+    uint64_t         len_ = 0;
+    uint8_t*         levels_ = nullptr;   // StateImageLevel[level_count]
+
+    void add_section(void* dst, uint64_t len);
+};
@@ -0,0 +1,138 @@
+#include "engine.h"
+#include "instruments.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// ------------------------------------------------------------
+// Cost of a runtime tick size:
+//   1. price <-> index conversion under FixedTicks<1> vs RuntimeTicks
+//   2. the same order flow through a book on the default tick (constant
+//      fast path) and one on a tick of 2 (runtime path), prices scaled so
+//      both books see identical matching
+// ------------------------------------------------------------
+
+constexpr uint32_t CONVERSIONS = 20'000'000;
+constexpr uint64_t EVENTS = 1'000'000;
+constexpr uint64_t ACCOUNTS = 1000;
+
+template <class Ticks>
+static double ns_per_conversion(const OrderBook& book,
+                                const std::vector<int64_t>& prices,
+                                int64_t& checksum) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t i = 0; i < CONVERSIONS; ++i) {
+        int32_t idx = book.price_to_index<Ticks>(prices[i & 4095]);
+        checksum += book.index_to_price<Ticks>(idx + 1);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / CONVERSIONS;
+}
+
+static void bench_conversion() {
+    auto* book = static_cast<OrderBook*>(std::calloc(1, sizeof(OrderBook)));
+    book->init(1'000'000, 1'000'000 + MAX_TICKS, TICK_SIZE);
+
+    std::mt19937 rng(7);
+    std::vector<int64_t> prices(4096);
+    for (auto& p : prices)
+        p = 1'000'000 + static_cast<int64_t>(rng() % MAX_TICKS);
+
+    int64_t sum_fixed = 0;
+    int64_t sum_runtime = 0;
+    double fixed =
+        ns_per_conversion<FixedTicks<TICK_SIZE>>(*book, prices, sum_fixed);
+    double runtime =
+        ns_per_conversion<RuntimeTicks>(*book, prices, sum_runtime);
+
+    if (sum_fixed != sum_runtime) {
+        std::fprintf(stderr, "conversion mismatch\n");
+        std::abort();
+    }
+
+    std::printf("[conversion] price -> index -> price\n");
+    std::printf("  fixed tick:   %6.2f ns\n", fixed);
+    std::printf("  runtime tick: %6.2f ns\n", runtime);
+
+    std::free(book);
+}
+
+// Same seed for every tick, so the flows differ only in price scale
+static double ns_per_event(int64_t tick, uint64_t& live) {
+    auto* state =
+        static_cast<EngineState*>(std::calloc(1, sizeof(EngineState)));
+    InstrumentSpec spec{0, tick, 1'000'000, 1'000'000 + MAX_TICKS * tick,
+                        false, LevelBackend::DENSE};
+    init_instrument(*state, spec);
+    MatchingEngine engine(*state);
+
+    for (uint64_t i = 0; i < ACCOUNTS; ++i) {
+        uint32_t slot = state->accounts.open(i);
+        state->accounts.hot[slot].base_available  = 1'000'000'000'000;
+        state->accounts.hot[slot].quote_available = 1'000'000'000'000;
+    }
+
+    std::mt19937_64 rng(99);
+    std::vector<EngineEvent> events(EVENTS);
+    for (uint64_t i = 0; i < EVENTS; ++i) {
+        EngineEvent& ev = events[i];
+        ev = EngineEvent{};
+        ev.header.sequence = i + 1;
+        ev.header.type = EventType::NEW_ORDER;
+        ev.new_order.account_id = rng() % ACCOUNTS;
+        ev.new_order.side       = static_cast<uint8_t>(rng() % 2);
+        ev.new_order.price      =
+            1'000'000 + static_cast<int64_t>(rng() % 2'000) * tick;
+        ev.new_order.quantity   = static_cast<int64_t>(rng() % 10) + 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const EngineEvent& ev : events)
+        engine.apply(ev);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    live = 0;
+    for (uint32_t oid = 1; oid < state->orders.slot_top; ++oid)
+        if (state->orders.hot[oid].state == OrderState::LIVE) ++live;
+
+    std::free(state);
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / EVENTS;
+}
+
+// Best of a few alternating rounds, so neither side alone pays for
+// first-touch page faults
+static void bench_engine() {
+    uint64_t live_fixed = 0;
+    uint64_t live_runtime = 0;
+    double fixed = 1e300;
+    double runtime = 1e300;
+    for (int round = 0; round < 3; ++round) {
+        fixed   = std::min(fixed, ns_per_event(TICK_SIZE, live_fixed));
+        runtime = std::min(runtime, ns_per_event(2, live_runtime));
+    }
+
+    if (live_fixed != live_runtime) {
+        std::fprintf(stderr, "engine flows diverged\n");
+        std::abort();
+    }
+
+    std::printf("[engine] %llu limit orders, %llu left resting\n",
+                static_cast<unsigned long long>(EVENTS),
+                static_cast<unsigned long long>(live_fixed));
+    std::printf("  tick 1 (fixed path):   %6.1f ns/event\n", fixed);
+    std::printf("  tick 2 (runtime path): %6.1f ns/event\n", runtime);
+}
+
+int main() {
+    bench_conversion();
+    bench_engine();
+}